@@ -0,0 +1,148 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "./context.hpp"
+#include <hwmalloc/heap.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/lockfree/stack.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+// Throughput of blocks which are allocated by one thread and freed by another: the producer
+// allocates and hands the pointers through a queue to the consumer, which frees them into the
+// producer's segments while the producer keeps allocating from the same pool. This is the pattern
+// in which the freed-block stacks and counters of segment and pool are written concurrently with
+// the allocation path, and where false sharing between them shows up.
+//  - local: allocate/free pairs on a single thread (reference)
+//  - cross: producer/consumer as above
+// The effect of the cache line padding is measured on a copy of the segment state below, once with
+// the layout of detail::segment and once packed:
+//  - padded/packed: the allocating thread updates its carving counter while another thread pushes
+//    and pops freed blocks and counts them
+//
+// usage: bench_cross_thread_free [blocks]
+
+namespace
+{
+using heap_t = hwmalloc::heap<bench_context>;
+using queue_t = boost::lockfree::spsc_queue<heap_t::pointer, boost::lockfree::capacity<1024>>;
+using stack_t = boost::lockfree::stack<void*>;
+
+// the fields of detail::segment which are read or written on the allocating and on the freeing
+// side, padded to cache lines as in the segment or packed
+template<bool Padded>
+struct segment_state
+{
+    static constexpr std::size_t line(std::size_t natural) { return Padded ? 64u : natural; }
+
+    void*       m_pool = nullptr;
+    std::size_t m_block_size = 64u;
+    std::size_t m_num_blocks = 1024u;
+    alignas(line(alignof(stack_t))) stack_t m_freed_stack{64u};
+    alignas(line(alignof(std::atomic<long>))) std::atomic<long> m_num_freed{0};
+    alignas(line(alignof(std::size_t))) std::size_t m_num_carved = 0u;
+};
+
+// carving steps per microsecond while another thread frees into the same segment
+template<bool Padded>
+double
+measure_layout(std::size_t n)
+{
+    auto              s = std::make_unique<segment_state<Padded>>();
+    std::atomic<bool> done{false};
+    std::thread       consumer(
+        [&s, &done]()
+        {
+            void* p = nullptr;
+            while (!done.load(std::memory_order_relaxed))
+            {
+                s->m_freed_stack.push(s.get());
+                s->m_freed_stack.pop(p);
+                s->m_num_freed.fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        // the allocating side reads the read-mostly fields and bumps its counter
+        auto& c = s->m_num_carved;
+        c = (c + s->m_block_size) % (s->m_num_blocks * s->m_block_size);
+        // keep the store in the loop
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    done.store(true);
+    consumer.join();
+    return n / std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+// blocks per microsecond
+double
+measure_local(heap_t& h, std::size_t size, std::size_t n)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < n; ++i) h.free(h.allocate(size, 0));
+    const auto stop = std::chrono::steady_clock::now();
+    return n / std::chrono::duration<double, std::micro>(stop - start).count();
+}
+
+double
+measure_cross(heap_t& h, std::size_t size, std::size_t n)
+{
+    queue_t    queue;
+    const auto start = std::chrono::steady_clock::now();
+    std::thread consumer(
+        [&h, &queue, n]()
+        {
+            heap_t::pointer p;
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                while (!queue.pop(p)) std::this_thread::yield();
+                h.free(p);
+            }
+        });
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto p = h.allocate(size, 0);
+        while (!queue.push(p)) std::this_thread::yield();
+    }
+    consumer.join();
+    const auto stop = std::chrono::steady_clock::now();
+    return n / std::chrono::duration<double, std::micro>(stop - start).count();
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    const std::size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000u;
+
+    bench_context c;
+    heap_t        h(&c);
+
+    std::printf("%8s %16s %16s\n", "size", "local [1/us]", "cross [1/us]");
+    for (std::size_t size : {32u, 256u, 4096u})
+    {
+        // warm up: create the segments
+        measure_cross(h, size, n / 10);
+        const auto r_local = measure_local(h, size, n);
+        const auto r_cross = measure_cross(h, size, n);
+        std::printf("%8zu %16.2f %16.2f\n", size, r_local, r_cross);
+    }
+
+    std::printf("\n%16s %16s\n", "padded [1/us]", "packed [1/us]");
+    const auto r_padded = measure_layout<true>(n * 10);
+    const auto r_packed = measure_layout<false>(n * 10);
+    std::printf("%16.2f %16.2f\n", r_padded, r_packed);
+    return 0;
+}
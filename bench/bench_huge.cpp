@@ -0,0 +1,137 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include "./context.hpp"
+#include <hwmalloc/heap.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Throughput of allocate/free pairs above the largest regular size class (8MiB - 64MiB) with an
+// increasing number of threads, for
+//  - map:   the dispatch of hwmalloc <= 0.4, a copy of its heap::get_heap huge branch: a mutex
+//           protected unordered_map of fixed_size_heaps created on demand
+//  - slots: heap::allocate (lock-free lookup of the huge heap)
+//
+// usage: bench_huge [iterations per thread] [max threads]
+
+namespace
+{
+using heap_t = hwmalloc::heap<bench_context>;
+using fixed_size_heap_t = hwmalloc::detail::fixed_size_heap<bench_context>;
+
+constexpr std::size_t sizes[] = {8388608u, 12582912u, 16777216u, 33554432u, 67108864u};
+
+// the former m_huge_heaps map, with the pool settings the heap derives for huge classes
+class map_dispatch
+{
+  private:
+    using heap_map = std::unordered_map<std::size_t, std::unique_ptr<fixed_size_heap_t>>;
+
+    bench_context*                   m_context;
+    hwmalloc::heap_config const&     m_config;
+    hwmalloc::detail::pool_config    m_pool_config;
+    hwmalloc::detail::size_class_map m_size_classes;
+    std::mutex                       m_mutex;
+    heap_map                         m_huge_heaps;
+
+  public:
+    map_dispatch(bench_context* context, hwmalloc::heap_config const& config)
+    : m_context{context}
+    , m_config{config}
+    , m_size_classes{config.m_tiny_limit, config.m_size_class_steps, config.m_small_limit}
+    {
+        m_pool_config.m_segment_decay_ms = config.m_segment_decay_ms;
+        m_pool_config.m_madvise = config.m_huge_madvise;
+        m_pool_config.m_prefault = config.m_huge_prefault;
+        m_pool_config.m_huge_page_size = config.m_huge_page_size;
+        m_pool_config.m_hugetlb = config.m_hugetlb;
+    }
+
+    fixed_size_heap_t* get_heap(std::size_t size)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto                  s = m_size_classes.round_up(size);
+        auto&                       u_ptr = m_huge_heaps[s];
+        if (!u_ptr)
+            u_ptr = std::make_unique<fixed_size_heap_t>(m_context, s, s, m_config.m_never_free,
+                m_config.m_num_reserve_segments, m_pool_config);
+        return u_ptr.get();
+    }
+
+    void operator()(std::size_t size)
+    {
+        auto b = get_heap(size)->allocate(0);
+        b.release();
+    }
+};
+
+struct heap_dispatch
+{
+    heap_t& m_heap;
+
+    void operator()(std::size_t size)
+    {
+        auto p = m_heap.allocate(size, 0);
+        m_heap.free(p);
+    }
+};
+
+// allocate/free pairs per microsecond
+template<typename Dispatch>
+double
+measure(Dispatch& d, std::size_t num_threads, std::size_t iterations)
+{
+    std::vector<std::thread> threads;
+    const auto               start = std::chrono::steady_clock::now();
+    for (std::size_t t = 0; t < num_threads; ++t)
+        threads.emplace_back(
+            [&d, t, iterations]()
+            {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    d(sizes[(i + t) % (sizeof(sizes) / sizeof(std::size_t))]);
+            });
+    for (auto& t : threads) t.join();
+    const auto stop = std::chrono::steady_clock::now();
+    return (num_threads * iterations) /
+           std::chrono::duration<double, std::micro>(stop - start).count();
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    const std::size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000u;
+    const std::size_t max_threads =
+        argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::thread::hardware_concurrency();
+
+    bench_context c;
+    const auto&   config = hwmalloc::get_default_heap_config();
+    heap_t        h(&c, config);
+    map_dispatch  m(&c, config);
+    heap_dispatch d{h};
+
+    // warm up: create the heaps and their segments
+    measure(m, max_threads, 100);
+    measure(d, max_threads, 100);
+
+    std::printf("%8s %16s %16s\n", "threads", "map [1/us]", "slots [1/us]");
+    for (std::size_t n = 1; n <= max_threads; n *= 2)
+    {
+        const auto r_map = measure(m, n, iterations);
+        const auto r_slots = measure(d, n, iterations);
+        std::printf("%8zu %16.2f %16.2f\n", n, r_map, r_slots);
+    }
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <hwmalloc/detail/size_classes.hpp>
+#include <hwmalloc/heap_config.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Cost of resolving the size class of a request, per power of two size class, for
+//  - legacy: branch cascade with the recursive detail::log2_c (dispatch of hwmalloc <= 0.4)
+//  - clz:    branch for tiny sizes, leading bit otherwise (detail::size_classes)
+//  - table:  lookup table up to the small limit, leading bit above (detail::size_class_map)
+//
+// usage: bench_size_class [iterations]
+
+namespace
+{
+constexpr std::size_t tiny_limit = hwmalloc::heap_config::tiny_limit_default;
+constexpr std::size_t small_limit = hwmalloc::heap_config::small_limit_default;
+constexpr std::size_t max_size = hwmalloc::heap_config::large_limit_default * 2;
+constexpr std::size_t num_tiny = tiny_limit >> hwmalloc::heap_config::m_tiny_increment_shift;
+
+struct legacy_dispatch
+{
+    std::size_t m_bucket_shift = hwmalloc::detail::log2_c(tiny_limit) - 1;
+
+    std::size_t operator()(std::size_t n) const noexcept
+    {
+        if (n <= tiny_limit)
+            return ((n + hwmalloc::heap_config::m_tiny_increment - 1) >>
+                       hwmalloc::heap_config::m_tiny_increment_shift) -
+                   1;
+        else if (n <= max_size)
+            return num_tiny + hwmalloc::detail::log2_c((n - 1) >> m_bucket_shift) - 1;
+        return ~std::size_t(0);
+    }
+};
+
+struct clz_dispatch
+{
+    hwmalloc::detail::size_classes m_classes{tiny_limit, 1};
+
+    std::size_t operator()(std::size_t n) const noexcept
+    {
+        if (n <= tiny_limit)
+            return ((n + hwmalloc::heap_config::m_tiny_increment - 1) >>
+                       hwmalloc::heap_config::m_tiny_increment_shift) -
+                   1;
+        else if (n <= max_size)
+            return num_tiny + m_classes.index(n);
+        return ~std::size_t(0);
+    }
+};
+
+struct table_dispatch
+{
+    hwmalloc::detail::size_class_map m_map{tiny_limit, 1, small_limit};
+
+    std::size_t operator()(std::size_t n) const noexcept
+    {
+        if (n <= max_size) return m_map.index(n);
+        return ~std::size_t(0);
+    }
+};
+
+// nanoseconds per lookup
+template<typename Dispatch>
+double
+measure(Dispatch const& d, std::vector<std::size_t> const& sizes, std::size_t iterations,
+    std::size_t& sink)
+{
+    const auto  start = std::chrono::steady_clock::now();
+    std::size_t sum = 0u;
+    for (std::size_t i = 0; i < iterations; ++i)
+        for (auto n : sizes) sum += d(n);
+    const auto stop = std::chrono::steady_clock::now();
+    sink += sum;
+    return std::chrono::duration<double, std::nano>(stop - start).count() /
+           (iterations * sizes.size());
+}
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    const std::size_t iterations = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000u;
+
+    legacy_dispatch legacy;
+    clz_dispatch    clz;
+    table_dispatch  table;
+
+    std::mt19937 gen(42);
+    std::size_t  sink = 0u;
+
+    std::printf("%12s %12s %12s %12s\n", "class", "legacy [ns]", "clz [ns]", "table [ns]");
+    std::size_t lower = 0u;
+    for (std::size_t upper = 8u; upper <= max_size; upper *= 2)
+    {
+        // random sizes within (lower, upper]
+        std::uniform_int_distribution<std::size_t> dist(lower + 1, upper);
+        std::vector<std::size_t>                   sizes(1024);
+        for (auto& n : sizes) n = dist(gen);
+
+        const auto t_legacy = measure(legacy, sizes, iterations, sink);
+        const auto t_clz = measure(clz, sizes, iterations, sink);
+        const auto t_table = measure(table, sizes, iterations, sink);
+        std::printf("%12zu %12.2f %12.2f %12.2f\n", upper, t_legacy, t_clz, t_table);
+        lower = upper;
+    }
+    return sink == 0u ? 1 : 0;
+}
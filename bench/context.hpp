@@ -0,0 +1,50 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+
+// Context without a transport layer: registration is a no-op, so that the benchmarks measure the
+// allocator alone.
+struct bench_context
+{
+    struct region
+    {
+        struct handle_type
+        {
+            void* ptr;
+        };
+
+        void* ptr = nullptr;
+
+        region(void* p) noexcept
+        : ptr{p}
+        {
+        }
+
+        region(region const&) = delete;
+        region(region&& other) noexcept
+        : ptr{other.ptr}
+        {
+            other.ptr = nullptr;
+        }
+
+        handle_type get_handle(std::size_t offset, std::size_t) const noexcept
+        {
+            return {(char*)ptr + offset};
+        }
+    };
+};
+
+inline auto
+register_memory(bench_context&, void* ptr, std::size_t)
+{
+    return bench_context::region{ptr};
+}
@@ -9,6 +9,7 @@
  */
 #pragma once
 
+#include <new>
 #include <utility>
 #include <type_traits>
 #include <hwmalloc/fancy_ptr/ptr.hpp>
@@ -89,9 +90,14 @@ class allocator
         return *this;
     }
 
+    // throws std::bad_alloc if the heap hits its memory limit without throwing itself
     pointer allocate(size_type n) //, const_void_pointer = const_void_pointer())
     {
-        return static_cast<pointer>(m_heap->allocate(n * sizeof(T), m_numa_node));
+        // single objects (e.g. nodes of lists and maps) take the compile time size path
+        auto p = (n == 1) ? m_heap->template allocate<sizeof(T)>(m_numa_node)
+                          : m_heap->allocate(n * sizeof(T), m_numa_node);
+        if (!p) throw std::bad_alloc();
+        return static_cast<pointer>(p);
     }
 
     void deallocate(pointer const& p, size_type) { m_heap->free(static_cast<void_pointer>(p)); }
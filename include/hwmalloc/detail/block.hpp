@@ -10,6 +10,7 @@
 #pragma once
 
 #include <hwmalloc/detail/region_traits.hpp>
+#include <cstddef>
 
 namespace hwmalloc
 {
@@ -21,21 +22,39 @@ class segment;
 template<typename Context>
 struct user_allocation;
 
+template<typename Context>
+struct extent;
+
+// storage of the handle in block_t, empty if handles are derived on demand (see lazy_handles)
+template<typename Handle, bool Lazy>
+struct block_handle
+{
+    Handle m_handle;
+};
+
+template<typename Handle>
+struct block_handle<Handle, true>
+{
+};
+
 template<typename Context>
 struct block_t
+: public block_handle<typename region_traits<Context>::handle_type,
+      region_traits<Context>::lazy_handles>
 {
     using region_traits_type = region_traits<Context>;
     using handle_type = typename region_traits_type::handle_type;
+    static constexpr bool lazy_handles = region_traits_type::lazy_handles;
 #if HWMALLOC_ENABLE_DEVICE
     using device_handle_type = typename region_traits_type::device_handle_type;
 #endif
     using segment_type = segment<Context>;
     using user_allocation_type = user_allocation<Context>;
+    using extent_type = extent<Context>;
 
     segment_type*         m_segment = nullptr;
     user_allocation_type* m_user_allocation = nullptr;
     void*                 m_ptr = nullptr;
-    handle_type           m_handle;
 #if HWMALLOC_ENABLE_DEVICE
     void*              m_device_ptr = nullptr;
     device_handle_type m_device_handle = device_handle_type();
@@ -45,15 +64,63 @@ struct block_t
 #else
     bool on_device() const noexcept { return false; }
 #endif
+    // huge host allocations served by the extent_heap
+    extent_type* m_extent = nullptr;
+
+    // accessors shared with compact_block_t, used by the fancy pointers
+    handle_type handle() const noexcept
+    {
+        if constexpr (lazy_handles) return owner_handle();
+        else
+            return this->m_handle;
+    }
+    block_t const& resolve() const noexcept { return *this; }
+#if HWMALLOC_ENABLE_DEVICE
+    void*              device_ptr() const noexcept { return m_device_ptr; }
+    device_handle_type device_handle() const noexcept { return m_device_handle; }
+    int                device_id() const noexcept { return m_device_id; }
+#endif
+
+    void advance(std::ptrdiff_t n) noexcept
+    {
+        m_ptr = (char*)m_ptr + n;
+#if HWMALLOC_ENABLE_DEVICE
+        if (m_device_ptr) m_device_ptr = (char*)m_device_ptr + n;
+#endif
+    }
+
+    // recompute the stored handle after the block's owner has changed, no-op with lazy handles
+    void update_handle() noexcept
+    {
+        if constexpr (!lazy_handles) this->m_handle = owner_handle();
+    }
+
+    // handle of the whole block, derived from the region of its owner
+    handle_type owner_handle() const noexcept
+    {
+        if (m_segment) return handle_from_segment();
+        else if (m_user_allocation)
+            return handle_from_user_allocation();
+        else if (m_extent)
+            return handle_from_extent();
+        return handle_type();
+    }
+
+    handle_type handle_from_segment() const noexcept;
+    handle_type handle_from_user_allocation() const noexcept;
+    handle_type handle_from_extent() const noexcept;
 
     void release_from_segment() const noexcept;
     void release_user_allocation() const noexcept;
+    void release_extent() const noexcept;
 
     void release() const noexcept
     {
         if (m_segment) release_from_segment();
         else if (m_user_allocation)
             release_user_allocation();
+        else if (m_extent)
+            release_extent();
     }
 };
 
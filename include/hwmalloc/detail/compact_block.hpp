@@ -0,0 +1,86 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/detail/block.hpp>
+#include <hwmalloc/detail/page_map.hpp>
+#include <hwmalloc/detail/segment.hpp>
+#include <hwmalloc/detail/extent_heap.hpp>
+#include <cstddef>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// Block of the compact fancy pointers (see compact_heap): only the address is stored, a pointer is
+// therefore as large as a raw pointer. The segment or extent which owns the address is looked up
+// in the page_map when the handle, the device mirror or the release is needed, and the metadata is
+// recomputed from there. Interior pointers resolve to the handle of their block, like the full
+// block_t. User allocations can not be represented.
+template<typename Context>
+struct compact_block_t
+{
+    using full_block_type = block_t<Context>;
+    using handle_type = typename full_block_type::handle_type;
+#if HWMALLOC_ENABLE_DEVICE
+    using device_handle_type = typename full_block_type::device_handle_type;
+#endif
+
+    void* m_ptr = nullptr;
+
+    compact_block_t() noexcept = default;
+
+    explicit compact_block_t(full_block_type const& b) noexcept
+    : m_ptr{b.m_ptr}
+    {
+    }
+
+    // the full block, with the address (and device pointer) at the same offset into the block
+    full_block_type resolve() const noexcept
+    {
+        full_block_type b;
+        if (!m_ptr) return b;
+        const auto e = page_map<Context>::instance().find(m_ptr);
+        if (e.m_segment)
+        {
+            b = e.m_segment->block_at(m_ptr);
+            if (b.m_ptr) b.advance((char*)m_ptr - (char*)b.m_ptr);
+            return b;
+        }
+        b.m_ptr = m_ptr;
+        b.m_extent = e.m_extent;
+        b.update_handle();
+        return b;
+    }
+
+    handle_type handle() const noexcept { return resolve().handle(); }
+#if HWMALLOC_ENABLE_DEVICE
+    void*              device_ptr() const noexcept { return resolve().m_device_ptr; }
+    device_handle_type device_handle() const noexcept { return resolve().m_device_handle; }
+    int                device_id() const noexcept { return resolve().m_device_id; }
+    bool               on_device() const noexcept { return resolve().on_device(); }
+#else
+    bool on_device() const noexcept { return false; }
+#endif
+
+    void advance(std::ptrdiff_t n) noexcept { m_ptr = (char*)m_ptr + n; }
+
+    void release() const noexcept
+    {
+        if (!m_ptr) return;
+        const auto e = page_map<Context>::instance().find(m_ptr);
+        if (e.m_segment) e.m_segment->block_at(m_ptr).release();
+        else if (e.m_extent)
+            e.m_extent->m_pool->free(e.m_extent);
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -0,0 +1,451 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/detail/block.hpp>
+#include <hwmalloc/detail/memory_budget.hpp>
+#include <hwmalloc/detail/page_map.hpp>
+#include <hwmalloc/detail/pool_stats.hpp>
+#include <hwmalloc/numa.hpp>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hwmalloc
+{
+namespace detail
+{
+template<typename Context>
+class extent_pool;
+
+// A large allocation which is registered once and handed out in page granular extents.
+template<typename Context>
+class extent_arena
+{
+  public:
+    using region_type = typename region_traits<Context>::region_type;
+    using handle_type = typename region_traits<Context>::handle_type;
+
+  private:
+    struct allocation_holder
+    {
+        numa_tools::allocation m;
+        ~allocation_holder() noexcept { hwmalloc::numa().free(m); }
+    };
+
+    allocation_holder m_allocation;
+    region_type       m_region;
+
+  public:
+    // start of the part which has never been handed out, guarded by the owning pool's mutex
+    char* m_untouched;
+
+    extent_arena(Context* context, numa_tools::allocation alloc)
+    : m_allocation{alloc}
+    , m_region{hwmalloc::register_memory(*context, alloc.ptr, alloc.size)}
+    , m_untouched{(char*)alloc.ptr}
+    {
+    }
+
+    extent_arena(extent_arena const&) = delete;
+    extent_arena(extent_arena&&) = delete;
+
+    char*       begin() const noexcept { return (char*)m_allocation.m.ptr; }
+    char*       end() const noexcept { return begin() + size(); }
+    std::size_t size() const noexcept { return m_allocation.m.size; }
+    bool        zeroed() const noexcept { return m_allocation.m.zeroed; }
+
+    handle_type get_handle(char* ptr, std::size_t size) const noexcept
+    {
+        return m_region.get_handle(ptr - begin(), size);
+    }
+};
+
+// An allocated range of pages, referenced by the block which owns it.
+template<typename Context>
+struct extent
+{
+    extent_pool<Context>*  m_pool;
+    extent_arena<Context>* m_arena;
+    char*                  m_ptr;
+    std::size_t            m_size;
+    // taken from zero-filled pages which were not handed out before
+    bool m_fresh = false;
+};
+
+// Best-fit allocator over the arenas of one numa node. Free extents are indexed by address (for
+// coalescing with their neighbours on free) and by size (for the best-fit search, ties are broken
+// by address). Extents never span arena boundaries. Arenas are created outside of the mutex and
+// are released when they become empty, except for a single one of the default arena size which
+// is kept as reserve. Freeing does not allocate: the index nodes which an extent needs when it is
+// returned are set aside when it is taken, and nodes of merged neighbours are reused.
+template<typename Context>
+class extent_pool
+{
+  public:
+    using block_type = block_t<Context>;
+    using arena_type = extent_arena<Context>;
+    using extent_type = extent<Context>;
+
+  private:
+    struct free_extent
+    {
+        std::size_t m_size;
+        arena_type* m_arena;
+    };
+
+    using arena_map = std::unordered_map<arena_type*, std::unique_ptr<arena_type>>;
+    using address_map = std::map<char*, free_extent>;
+    using size_set = std::set<std::pair<std::size_t, char*>>;
+    using node_pair = std::pair<typename address_map::node_type, typename size_set::node_type>;
+
+    Context*       m_context;
+    std::size_t    m_numa_node;
+    std::size_t    m_arena_size;
+    std::size_t    m_huge_page_size;
+    bool           m_hugetlb;
+    bool           m_never_free;
+    memory_budget* m_budget;
+    bool           m_page_map;
+    std::mutex     m_mutex;
+    arena_map      m_arenas;
+    address_map    m_free_by_address;
+    size_set       m_free_by_size;
+    // one pair of index nodes per allocated extent
+    std::vector<node_pair> m_spare_nodes;
+
+  public:
+    // extents are entered in the page map if page_map is set
+    extent_pool(Context* context, std::size_t numa_node, std::size_t arena_size, bool never_free,
+        memory_budget* budget, std::size_t huge_page_size = 0u, bool hugetlb = false,
+        bool page_map = true)
+    : m_context{context}
+    , m_numa_node{numa_node}
+    , m_arena_size{round_up(arena_size)}
+    , m_huge_page_size{huge_page_size}
+    , m_hugetlb{hugetlb}
+    , m_never_free{never_free}
+    , m_budget{budget}
+    , m_page_map{page_map}
+    {
+    }
+
+    extent_pool(extent_pool const&) = delete;
+    extent_pool(extent_pool&&) = delete;
+
+    ~extent_pool()
+    {
+        if (m_budget)
+            for (auto& kvp : m_arenas) m_budget->release(m_numa_node, kvp.first->size());
+    }
+
+    static std::size_t round_up(std::size_t size) noexcept
+    {
+        const auto page_size = numa().page_size();
+        return ((size + page_size - 1) / page_size) * page_size;
+    }
+
+    std::size_t numa_node() const noexcept { return m_numa_node; }
+
+    block_type allocate(std::size_t size)
+    {
+        const auto                   bytes = round_up(std::max<std::size_t>(size, 1u));
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            auto it = m_free_by_size.lower_bound({bytes, nullptr});
+            if (it != m_free_by_size.end()) return take(it->second, bytes);
+            // a new arena is registered without holding the mutex
+            lock.unlock();
+            auto a = make_arena(arena_bytes(std::max(bytes, m_arena_size)));
+            lock.lock();
+            insert_free(a->begin(), a->size(), a.get());
+            m_arenas[a.get()] = std::move(a);
+        }
+    }
+
+    void free(extent_type* e) noexcept
+    {
+        std::unique_ptr<arena_type> empty;
+        if (m_page_map) page_map<Context>::instance().erase(e->m_ptr, e->m_size);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto                        ptr = e->m_ptr;
+            auto                        size = e->m_size;
+            auto                        arena = e->m_arena;
+            auto                        nodes = std::move(m_spare_nodes.back());
+            m_spare_nodes.pop_back();
+            // merge with the following extent
+            auto next = m_free_by_address.find(ptr + size);
+            if (next != m_free_by_address.end() && next->second.m_arena == arena)
+            {
+                size += next->second.m_size;
+                nodes = extract_free(next);
+            }
+            // merge with the preceding extent
+            auto prev = m_free_by_address.lower_bound(ptr);
+            if (prev != m_free_by_address.begin())
+            {
+                --prev;
+                if (prev->second.m_arena == arena && prev->first + prev->second.m_size == ptr)
+                {
+                    ptr = prev->first;
+                    size += prev->second.m_size;
+                    nodes = extract_free(prev);
+                }
+            }
+            insert_free(std::move(nodes), ptr, size, arena);
+            if (size == arena->size() && !keep(arena)) empty = remove_arena(arena);
+        }
+        delete e;
+        // deregistration happens outside of the mutex
+    }
+
+    // extend e in place into the free extent which follows it: returns false if there is not
+    // enough room
+    bool grow(extent_type* e, std::size_t size)
+    {
+        const auto bytes = round_up(size);
+        if (bytes <= e->m_size) return true;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto                        next = m_free_by_address.find(e->m_ptr + e->m_size);
+        if (next == m_free_by_address.end() || next->second.m_arena != e->m_arena) return false;
+        const auto delta = bytes - e->m_size;
+        const auto f = next->second;
+        if (f.m_size < delta) return false;
+        if (m_page_map) page_map<Context>::instance().insert(e->m_ptr + e->m_size, delta, e);
+        e->m_arena->m_untouched = std::max(e->m_arena->m_untouched, e->m_ptr + bytes);
+        auto nodes = extract_free(next);
+        if (f.m_size > delta)
+            insert_free(std::move(nodes), e->m_ptr + bytes, f.m_size - delta, f.m_arena);
+        e->m_size = bytes;
+        return true;
+    }
+
+    // release all empty arenas
+    void purge()
+    {
+        if (m_never_free) return;
+        std::vector<std::unique_ptr<arena_type>> empty;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<arena_type*>    arenas;
+            for (auto& kvp : m_free_by_address)
+                if (kvp.second.m_size == kvp.second.m_arena->size())
+                    arenas.push_back(kvp.second.m_arena);
+            for (auto a : arenas) empty.push_back(remove_arena(a));
+        }
+    }
+
+    pool_stats stats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pool_stats                  res;
+        res.m_num_segments = m_arenas.size();
+        for (auto& kvp : m_arenas) res.m_registered_bytes += kvp.first->size();
+        res.m_resident_bytes = res.m_registered_bytes;
+        return res;
+    }
+
+  private:
+    // split the free extent at ptr, m_mutex is locked
+    block_type take(char* ptr, std::size_t bytes)
+    {
+        auto       it = m_free_by_address.find(ptr);
+        const auto f = it->second;
+        // allocate before the free extent is modified
+        m_spare_nodes.reserve(m_spare_nodes.size() + 1);
+        auto spare = f.m_size > bytes ? make_nodes() : node_pair{};
+        auto e = std::make_unique<extent_type>(extent_type{this, f.m_arena, ptr, bytes,
+            f.m_arena->zeroed() && ptr >= f.m_arena->m_untouched});
+        auto nodes = extract_free(it);
+        if (f.m_size > bytes)
+        {
+            // the remainder keeps the nodes of the free extent, the new ones are set aside
+            insert_free(std::move(nodes), ptr + bytes, f.m_size - bytes, f.m_arena);
+            nodes = std::move(spare);
+        }
+        m_spare_nodes.push_back(std::move(nodes));
+        f.m_arena->m_untouched = std::max(f.m_arena->m_untouched, ptr + bytes);
+        block_type b;
+        b.m_ptr = ptr;
+        b.m_extent = e.release();
+        b.update_handle();
+        if (m_page_map) page_map<Context>::instance().insert(ptr, bytes, b.m_extent);
+        return b;
+    }
+
+    void insert_free(char* ptr, std::size_t size, arena_type* arena)
+    {
+        m_free_by_address.emplace(ptr, free_extent{size, arena});
+        m_free_by_size.emplace(size, ptr);
+    }
+
+    // insert with the nodes of an extracted free extent, does not allocate
+    void insert_free(node_pair&& nodes, char* ptr, std::size_t size, arena_type* arena) noexcept
+    {
+        nodes.first.key() = ptr;
+        nodes.first.mapped() = free_extent{size, arena};
+        nodes.second.value() = {size, ptr};
+        m_free_by_address.insert(std::move(nodes.first));
+        m_free_by_size.insert(std::move(nodes.second));
+    }
+
+    node_pair extract_free(typename address_map::iterator it) noexcept
+    {
+        auto s = m_free_by_size.extract({it->second.m_size, it->first});
+        return {m_free_by_address.extract(it), std::move(s)};
+    }
+
+    // a pair of nodes which are not linked into a container
+    static node_pair make_nodes()
+    {
+        address_map a;
+        size_set    s;
+        a.emplace(nullptr, free_extent{0u, nullptr});
+        s.emplace(0u, nullptr);
+        return {a.extract(a.begin()), s.extract(s.begin())};
+    }
+
+    void erase_free(typename address_map::iterator it)
+    {
+        m_free_by_size.erase({it->second.m_size, it->first});
+        m_free_by_address.erase(it);
+    }
+
+    // an empty arena is kept if it is the last one and has the default size
+    bool keep(arena_type* arena) const noexcept
+    {
+        return m_never_free || (m_arenas.size() == 1u && arena->size() == m_arena_size);
+    }
+
+    // arena must be empty, m_mutex is locked
+    std::unique_ptr<arena_type> remove_arena(arena_type* arena)
+    {
+        erase_free(m_free_by_address.find(arena->begin()));
+        auto it = m_arenas.find(arena);
+        auto a = std::move(it->second);
+        m_arenas.erase(it);
+        if (m_budget) m_budget->release(m_numa_node, a->size());
+        return a;
+    }
+
+    // arenas are a multiple of the huge page size, such that they can be backed by huge pages
+    std::size_t arena_bytes(std::size_t bytes) const noexcept
+    {
+        if (m_huge_page_size <= numa().page_size()) return bytes;
+        return ((bytes + m_huge_page_size - 1) / m_huge_page_size) * m_huge_page_size;
+    }
+
+    std::unique_ptr<arena_type> make_arena(std::size_t bytes)
+    {
+        if (m_budget) m_budget->reserve(m_numa_node, bytes);
+        try
+        {
+            auto a = numa().allocate_huge(bytes, m_numa_node, m_huge_page_size, m_hugetlb);
+            if (!a) throw std::runtime_error("could not allocate system memory");
+            else if (a.node != m_numa_node)
+            {
+                numa().free(a);
+                throw std::runtime_error(
+                    "could not allocate on requested numa node " + std::to_string(m_numa_node));
+            }
+            return std::make_unique<arena_type>(m_context, a);
+        }
+        catch (...)
+        {
+            if (m_budget) m_budget->release(m_numa_node, bytes);
+            throw;
+        }
+    }
+};
+
+// Host allocations above the largest size class: one extent_pool per numa node.
+template<typename Context>
+class extent_heap
+{
+  public:
+    using pool_type = extent_pool<Context>;
+    using block_type = typename pool_type::block_type;
+
+  private:
+    std::vector<std::unique_ptr<pool_type>> m_pools;
+
+  public:
+    extent_heap(Context* context, std::size_t arena_size, bool never_free, memory_budget* budget,
+        std::size_t huge_page_size = 0u, bool hugetlb = false, bool page_map = true)
+    : m_pools(numa().local_nodes().size())
+    {
+        for (auto [n, i] : numa().local_nodes())
+            m_pools[i] = std::make_unique<pool_type>(context, n, arena_size, never_free, budget,
+                huge_page_size, hugetlb, page_map);
+    }
+
+    extent_heap(extent_heap const&) = delete;
+    extent_heap(extent_heap&&) = delete;
+
+    block_type allocate(std::size_t numa_node, std::size_t size)
+    {
+        return m_pools[numa_node_index(numa_node)]->allocate(size);
+    }
+
+    void purge()
+    {
+        for (auto& p : m_pools) p->purge();
+    }
+
+    // p is one of the pools of this heap
+    bool owns(pool_type const* p) const noexcept
+    {
+        for (auto const& q : m_pools)
+            if (q.get() == p) return true;
+        return false;
+    }
+
+    pool_stats stats()
+    {
+        pool_stats res;
+        for (auto& p : m_pools) res += p->stats();
+        return res;
+    }
+
+  private:
+    auto numa_node_index(std::size_t numa_node) const noexcept
+    {
+        auto it = numa().local_nodes().find(numa_node);
+        return (it != numa().local_nodes().end()
+                    ? it->second
+                    : numa().local_nodes().find(numa().local_node())->second);
+    }
+};
+
+template<typename Context>
+typename block_t<Context>::handle_type
+block_t<Context>::handle_from_extent() const noexcept
+{
+    return m_extent->m_arena->get_handle(m_extent->m_ptr, m_extent->m_size);
+}
+
+template<typename Context>
+void
+block_t<Context>::release_extent() const noexcept
+{
+    m_extent->m_pool->free(m_extent);
+}
+
+} // namespace detail
+} // namespace hwmalloc
@@ -22,6 +22,7 @@ class fixed_size_heap
   public:
     using pool_type = pool<Context>;
     using block_type = typename pool_type::block_type;
+    using arena_heap_type = typename pool_type::arena_heap_type;
 
   private:
     Context*                                m_context;
@@ -29,6 +30,8 @@ class fixed_size_heap
     std::size_t                             m_segment_size;
     bool                                    m_never_free;
     std::size_t                             m_num_reserve_segments;
+    pool_config                             m_pool_config;
+    arena_heap_type*                        m_arenas;
     std::vector<std::unique_ptr<pool_type>> m_pools;
 #if HWMALLOC_ENABLE_DEVICE
     std::size_t                             m_num_devices;
@@ -37,12 +40,15 @@ class fixed_size_heap
 
   public:
     fixed_size_heap(Context* context, std::size_t block_size, std::size_t segment_size,
-        bool never_free, std::size_t num_reserve_segments)
+        bool never_free, std::size_t num_reserve_segments, pool_config const& config = {},
+        arena_heap_type* arenas = nullptr)
     : m_context(context)
     , m_block_size(block_size)
     , m_segment_size(segment_size)
     , m_never_free(never_free)
     , m_num_reserve_segments{num_reserve_segments}
+    , m_pool_config{config}
+    , m_arenas{arenas}
     , m_pools(numa().local_nodes().size())
 #if HWMALLOC_ENABLE_DEVICE
     , m_num_devices{(std::size_t)get_num_devices()}
@@ -52,12 +58,13 @@ class fixed_size_heap
         for (auto [n, i] : numa().local_nodes())
         {
             m_pools[i] = std::make_unique<pool_type>(m_context, m_block_size, m_segment_size, n,
-                m_never_free, m_num_reserve_segments);
+                m_never_free, m_num_reserve_segments, m_pool_config, m_arenas);
 #if HWMALLOC_ENABLE_DEVICE
             for (unsigned int j = 0; j < m_num_devices; ++j)
             {
                 m_device_pools[i * m_num_devices + j] = std::make_unique<pool_type>(m_context,
-                    m_block_size, m_segment_size, n, (int)j, m_never_free, m_num_reserve_segments);
+                    m_block_size, m_segment_size, n, (int)j, m_never_free, m_num_reserve_segments,
+                    m_pool_config);
             }
 #endif
         }
@@ -66,6 +73,8 @@ class fixed_size_heap
     fixed_size_heap(fixed_size_heap const&) = delete;
     fixed_size_heap(fixed_size_heap&&) = default;
 
+    std::size_t block_size() const noexcept { return m_block_size; }
+
     block_type allocate(std::size_t numa_node)
     {
         return m_pools[numa_node_index(numa_node)]->allocate();
@@ -78,8 +87,42 @@ class fixed_size_heap
     }
 #endif
 
+    template<typename OutputIterator>
+    OutputIterator allocate_bulk(std::size_t numa_node, std::size_t count, OutputIterator out)
+    {
+        return m_pools[numa_node_index(numa_node)]->allocate_bulk(count, out);
+    }
+
+#if HWMALLOC_ENABLE_DEVICE
+    template<typename OutputIterator>
+    OutputIterator allocate_bulk(std::size_t numa_node, int device_id, std::size_t count,
+        OutputIterator out)
+    {
+        return m_device_pools[numa_node_index(numa_node) * m_num_devices + device_id]
+            ->allocate_bulk(count, out);
+    }
+#endif
+
     void free(block_type const& b) { b.release(); }
 
+    void purge()
+    {
+        for (auto& p : m_pools) p->purge();
+#if HWMALLOC_ENABLE_DEVICE
+        for (auto& p : m_device_pools) p->purge();
+#endif
+    }
+
+    pool_stats stats()
+    {
+        pool_stats res;
+        for (auto& p : m_pools) res += p->stats();
+#if HWMALLOC_ENABLE_DEVICE
+        for (auto& p : m_device_pools) res += p->stats();
+#endif
+        return res;
+    }
+
   private:
     auto numa_node_index(std::size_t numa_node) const noexcept
     {
@@ -0,0 +1,137 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/numa.hpp>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace hwmalloc
+{
+// Thrown when a segment can not be created without exceeding the heap's memory limit.
+class budget_exceeded : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail
+{
+// Accounts the memory of all segments of a heap against a global and a per numa node limit. The
+// usage is kept in one counter per numa node (on separate cache lines); the global usage is the
+// sum over all nodes. A reservation is added first and checked afterwards, therefore concurrent
+// reservations can never overshoot a limit (at worst both are rolled back). Crossing the soft
+// limit invokes the purge callback, which is expected to release unused memory.
+class memory_budget
+{
+  private:
+    struct alignas(64) shard
+    {
+        std::atomic<std::size_t> m_bytes{0u};
+    };
+
+    std::size_t              m_limit;
+    std::size_t              m_soft_limit;
+    std::size_t              m_node_limit;
+    std::size_t              m_num_shards;
+    std::unique_ptr<shard[]> m_shards;
+    std::function<void()>    m_purge;
+    std::mutex               m_purge_mutex;
+
+  public:
+    // a limit of 0 means unlimited
+    memory_budget(std::size_t limit, std::size_t soft_limit, std::size_t node_limit)
+    : m_limit{limit}
+    , m_soft_limit{soft_limit}
+    , m_node_limit{node_limit}
+    , m_num_shards{numa().local_nodes().size()}
+    , m_shards{new shard[m_num_shards]}
+    {
+    }
+
+    memory_budget(memory_budget const&) = delete;
+    memory_budget(memory_budget&&) = delete;
+
+    // waits for a running purge: the previous callback is not invoked after this returns
+    void set_purge_callback(std::function<void()> f)
+    {
+        std::lock_guard<std::mutex> lock(m_purge_mutex);
+        m_purge = std::move(f);
+    }
+
+    std::size_t limit() const noexcept { return m_limit; }
+    std::size_t soft_limit() const noexcept { return m_soft_limit; }
+    std::size_t node_limit() const noexcept { return m_node_limit; }
+
+    std::size_t used() const noexcept
+    {
+        std::size_t res = 0u;
+        for (std::size_t i = 0; i < m_num_shards; ++i) res += m_shards[i].m_bytes.load();
+        return res;
+    }
+
+    std::size_t used(std::size_t numa_node) const noexcept
+    {
+        return m_shards[shard_index(numa_node)].m_bytes.load();
+    }
+
+    // account for bytes on numa_node: purges and retries once if a limit would be exceeded, then
+    // throws budget_exceeded
+    void reserve(std::size_t numa_node, std::size_t bytes)
+    {
+        if (!try_reserve(numa_node, bytes))
+        {
+            purge();
+            if (!try_reserve(numa_node, bytes))
+                throw budget_exceeded("hwmalloc: memory limit exceeded while allocating " +
+                                      std::to_string(bytes) + " bytes on numa node " +
+                                      std::to_string(numa_node));
+        }
+        if (m_soft_limit > 0u && used() > m_soft_limit) purge();
+    }
+
+    void release(std::size_t numa_node, std::size_t bytes) noexcept
+    {
+        m_shards[shard_index(numa_node)].m_bytes.fetch_sub(bytes);
+    }
+
+  private:
+    std::size_t shard_index(std::size_t numa_node) const noexcept
+    {
+        auto it = numa().local_nodes().find(numa_node);
+        return it != numa().local_nodes().end() ? it->second : 0u;
+    }
+
+    bool try_reserve(std::size_t numa_node, std::size_t bytes) noexcept
+    {
+        auto&      s = m_shards[shard_index(numa_node)].m_bytes;
+        const auto node_bytes = s.fetch_add(bytes) + bytes;
+        if ((m_node_limit > 0u && node_bytes > m_node_limit) || (m_limit > 0u && used() > m_limit))
+        {
+            s.fetch_sub(bytes);
+            return false;
+        }
+        return true;
+    }
+
+    // only one thread purges at a time, others carry on
+    void purge()
+    {
+        std::unique_lock<std::mutex> lock(m_purge_mutex, std::try_to_lock);
+        if (lock && m_purge) m_purge();
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -0,0 +1,156 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/detail/block.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// Maps every page of the segments and extents of the heaps of one Context which are configured for
+// it (heap_config::m_page_map, compact heaps) to its owner. This is a radix tree over the page
+// number of 48 bit virtual addresses (4KiB pages, independent of the system page size) with three
+// levels of 4096 entries. Interior nodes are created on demand with a compare-and-swap and are
+// never released, so that a lookup is three dependent loads without any lock. Leaf entries are
+// tagged pointers to a segment or an extent. Ranges are inserted when the memory is handed to an
+// owner and erased before it is given back, which costs one store per 4KiB page.
+//
+// Memory: every inner and leaf node takes 32KiB. A leaf covers 16MiB of address space and an inner
+// node 64GiB, so the leaves add 0.2% to large ranges while small scattered ranges may need a leaf
+// each. Nodes are kept for the lifetime of the process, even after the memory they describe was
+// released.
+template<typename Context>
+class page_map
+{
+  public:
+    using segment_type = segment<Context>;
+    using extent_type = extent<Context>;
+
+    static constexpr std::size_t page_shift = 12u;
+    static constexpr std::size_t level_bits = 12u;
+    static constexpr std::size_t fanout = std::size_t(1) << level_bits;
+    static constexpr std::size_t address_bits = page_shift + 3 * level_bits;
+
+    struct entry
+    {
+        segment_type* m_segment = nullptr;
+        extent_type*  m_extent = nullptr;
+    };
+
+  private:
+    enum tag : std::uintptr_t
+    {
+        segment_tag = 1u,
+        extent_tag = 2u,
+        tag_mask = 3u
+    };
+
+    struct leaf_node
+    {
+        std::atomic<std::uintptr_t> m_entries[fanout];
+    };
+
+    struct inner_node
+    {
+        std::atomic<leaf_node*> m_children[fanout];
+    };
+
+    std::atomic<inner_node*> m_root[fanout];
+
+    page_map() noexcept
+    {
+        for (auto& r : m_root) r.store(nullptr, std::memory_order_relaxed);
+    }
+
+  public:
+    page_map(page_map const&) = delete;
+    page_map(page_map&&) = delete;
+
+    // never destroyed: heaps with static storage duration may still free blocks at exit
+    static page_map& instance()
+    {
+        static page_map* m = new page_map();
+        return *m;
+    }
+
+    void insert(void const* ptr, std::size_t size, segment_type* s)
+    {
+        set(ptr, size, reinterpret_cast<std::uintptr_t>(s) | segment_tag);
+    }
+
+    void insert(void const* ptr, std::size_t size, extent_type* e)
+    {
+        set(ptr, size, reinterpret_cast<std::uintptr_t>(e) | extent_tag);
+    }
+
+    void erase(void const* ptr, std::size_t size) { set(ptr, size, 0u); }
+
+    entry find(void const* ptr) const noexcept
+    {
+        const auto p = page(ptr);
+        if (p >> (3 * level_bits)) return {};
+        auto inner = m_root[p >> (2 * level_bits)].load(std::memory_order_acquire);
+        if (!inner) return {};
+        auto leaf = inner->m_children[(p >> level_bits) & (fanout - 1)].load(
+            std::memory_order_acquire);
+        if (!leaf) return {};
+        const auto v = leaf->m_entries[p & (fanout - 1)].load(std::memory_order_acquire);
+        const auto owner = v & ~std::uintptr_t(tag_mask);
+        if ((v & tag_mask) == segment_tag) return {reinterpret_cast<segment_type*>(owner), nullptr};
+        if ((v & tag_mask) == extent_tag) return {nullptr, reinterpret_cast<extent_type*>(owner)};
+        return {};
+    }
+
+  private:
+    static std::uintptr_t page(void const* ptr) noexcept
+    {
+        return reinterpret_cast<std::uintptr_t>(ptr) >> page_shift;
+    }
+
+    // assign v to all pages overlapping [ptr, ptr + size), nodes are only created for v != 0
+    void set(void const* ptr, std::size_t size, std::uintptr_t v)
+    {
+        const auto first = page(ptr);
+        const auto last = std::min<std::uintptr_t>(
+            page(static_cast<char const*>(ptr) + size + (1u << page_shift) - 1),
+            std::uintptr_t(1) << (3 * level_bits));
+        // one leaf at a time
+        for (auto p = first; p < last;)
+        {
+            const auto leaf_end = std::min<std::uintptr_t>((p | (fanout - 1)) + 1, last);
+            leaf_node* leaf = nullptr;
+            if (auto inner = get_or_create(m_root[p >> (2 * level_bits)], v))
+                leaf = get_or_create(inner->m_children[(p >> level_bits) & (fanout - 1)], v);
+            for (auto q = p; leaf && q < leaf_end; ++q)
+                leaf->m_entries[q & (fanout - 1)].store(v, std::memory_order_release);
+            p = leaf_end;
+        }
+    }
+
+    template<typename Node>
+    static Node* get_or_create(std::atomic<Node*>& slot, std::uintptr_t v)
+    {
+        auto node = slot.load(std::memory_order_acquire);
+        if (node || !v) return node;
+        auto fresh = new Node();
+        if (slot.compare_exchange_strong(node, fresh, std::memory_order_acq_rel)) return fresh;
+        // another thread was faster
+        delete fresh;
+        return node;
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -10,23 +10,84 @@
 #pragma once
 
 #include <hwmalloc/detail/segment.hpp>
+#include <hwmalloc/detail/pool_stats.hpp>
+#include <hwmalloc/detail/thread_cache.hpp>
+#include <hwmalloc/detail/provisioner.hpp>
+#include <hwmalloc/detail/memory_budget.hpp>
+#include <boost/iterator/function_output_iterator.hpp>
 #include <unordered_map>
 #include <mutex>
+#include <condition_variable>
 #include <memory>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <vector>
 
 namespace hwmalloc
 {
 namespace detail
 {
+// Optional pool features. The heap derives these settings from its heap_config.
+struct pool_config
+{
+    // number of blocks each thread may cache in front of the pool (0: no thread caches)
+    std::size_t m_thread_cache_size = 0u;
+    // maximum number of bytes a thread keeps in all of its caches
+    std::size_t m_thread_cache_max_bytes = 0u;
+    // hand out the blocks of new segments on demand instead of pushing all of them to the free
+    // stack when the segment is created
+    bool m_lazy_carving = false;
+    // background worker (none if null): when the number of spare segments drops below the low
+    // watermark, it builds new ones up to the high watermark, and it releases parked segments once
+    // the decay time has passed
+    provisioner* m_provisioner = nullptr;
+    std::size_t  m_provision_low_watermark = 0u;
+    std::size_t  m_provision_high_watermark = 0u;
+    // empty segments beyond the reserve are released only after they stayed unused for this many
+    // milliseconds (0: release immediately)
+    std::size_t m_segment_decay_ms = 0u;
+    // instead of releasing empty segments, give their pages back to the OS with madvise and keep
+    // the segments (and their registration) for reuse
+    bool m_madvise = false;
+    // fault in the pages of new segments when they are built
+    bool m_prefault = false;
+    // memory limits shared by all pools of a heap (unlimited if null)
+    memory_budget* m_budget = nullptr;
+    // back segments which are a multiple of this size by huge pages (see numa_tools::allocate_huge,
+    // 0: regular pages), taken from the hugetlbfs pool if m_hugetlb is set
+    std::size_t m_huge_page_size = 0u;
+    bool        m_hugetlb = false;
+    // enter the pages of the segments into the page map
+    bool m_page_map = false;
+    // the heap the pool belongs to, identifies its blocks in the page map
+    void const* m_owner = nullptr;
+};
+
 template<typename Context>
 class pool
 {
   public:
     using segment_type = segment<Context>;
+    using arena_heap_type = extent_heap<Context>;
     using block_type = typename segment_type::block;
     using stack_type = boost::lockfree::stack<block_type>;
     using segment_map = std::unordered_map<segment_type*, std::unique_ptr<segment_type>>;
+    using segment_stack_type = boost::lockfree::stack<segment_type*>;
+    using thread_cache_type = thread_cache<Context>;
+    using thread_cache_set_type = thread_cache_set<Context>;
+    using thread_cache_registry_type = thread_cache_registry<Context>;
+    using clock_type = std::chrono::steady_clock;
+    struct parked_segment
+    {
+        clock_type::time_point m_time;
+        // bytes given back to the OS (madvise mode)
+        std::size_t m_released_bytes = 0u;
+    };
+    using parked_segment_map = std::unordered_map<segment_type*, parked_segment>;
 
   private:
     static std::size_t num_pages(std::size_t segment_size) noexcept
@@ -48,22 +109,83 @@ class pool
     }
 
   private:
+    // Layout: the read-mostly configuration comes first. The free stack (popped by allocating
+    // threads), the pending segments (pushed by freeing threads) and the mutex each start a new
+    // cache line, so that traffic on one of them does not invalidate the others or the
+    // configuration.
     Context*    m_context;
     std::size_t m_block_size;
     std::size_t m_segment_size;
     std::size_t m_numa_node;
     bool        m_never_free;
     std::size_t m_num_reserve_segments;
-    stack_type  m_free_stack;
-    segment_map m_segments;
-    std::mutex  m_mutex;
     int         m_device_id = 0;
     bool        m_allocate_on_device = false;
+    pool_config m_config;
+    // host segments are carved from these arenas, sharing their registration (own allocation and
+    // registration per segment if null)
+    arena_heap_type* m_arenas = nullptr;
+    // slot of this pool in the threads' cache sets, guarded by the thread_cache_registry mutex
+    std::size_t m_cache_id = 0u;
+    alignas(64) stack_type m_free_stack;
+    // segments which received freed blocks since they were last collected: pushed lock-free by
+    // freeing threads, consumed with m_mutex locked
+    alignas(64) segment_stack_type m_pending_segments;
+    alignas(64) std::mutex m_mutex;
+    segment_map m_segments;
+    // list of attached caches, guarded by the thread_cache_registry mutex
+    std::vector<thread_cache_type*> m_caches;
+    // most recently added lazy segment and scratch space for carving, guarded by m_mutex
+    segment_type*           m_carve_segment = nullptr;
+    std::vector<block_type> m_carve_buffer;
+    // segments built by the provisioner which have not been used yet
+    std::mutex                                 m_spare_mutex;
+    std::vector<std::unique_ptr<segment_type>> m_spare_segments;
+    std::atomic<bool>                          m_provisioning{false};
+    // set while a thread builds a new segment outside of m_mutex, other threads wait on m_grow_cv
+    bool                    m_growing = false;
+    std::condition_variable m_grow_cv;
+    // empty segments waiting to be released (with decay enabled) and the time they became empty,
+    // guarded by m_mutex
+    parked_segment_map m_parked_segments;
+    // total number of bytes and number of parked segments which were released with madvise
+    std::size_t m_released_bytes = 0u;
+    std::size_t m_num_released_segments = 0u;
+    // a decay is scheduled on the worker thread, guarded by m_mutex
+    bool m_decay_scheduled = false;
 
-    void add_segment()
+    std::size_t segment_bytes() const noexcept
     {
-        auto a =
-            check_allocation(numa().allocate(num_pages(m_segment_size), m_numa_node), m_numa_node);
+        return num_pages(m_segment_size) * numa().page_size();
+    }
+
+    // allocate and register a new segment with no block carved yet, which is not yet visible to
+    // the allocating threads: the memory is accounted against the budget first
+    std::unique_ptr<segment_type> make_segment()
+    {
+        if (!m_config.m_budget) return populate(build_segment());
+        m_config.m_budget->reserve(m_numa_node, segment_bytes());
+        try
+        {
+            return populate(build_segment());
+        }
+        catch (...)
+        {
+            m_config.m_budget->release(m_numa_node, segment_bytes());
+            throw;
+        }
+    }
+
+    std::unique_ptr<segment_type> build_segment()
+    {
+        if (m_arenas && !m_allocate_on_device)
+        {
+            auto b = m_arenas->allocate(m_numa_node, segment_bytes());
+            return std::make_unique<segment_type>(this, b.m_extent, m_block_size);
+        }
+        auto a = check_allocation(numa().allocate_huge(segment_bytes(), m_numa_node,
+                                      m_config.m_huge_page_size, m_config.m_hugetlb),
+            m_numa_node);
 #if HWMALLOC_ENABLE_DEVICE
         if (m_allocate_on_device)
         {
@@ -73,92 +195,556 @@ class pool
 
             auto s = std::make_unique<segment_type>(this,
                 hwmalloc::register_memory(*m_context, a.ptr, a.size), a,
-                hwmalloc::register_device_memory(*m_context, m_device_id, device_ptr, a.size), device_ptr,
-                m_device_id, m_block_size, m_free_stack);
-            m_segments[s.get()] = std::move(s);
+                hwmalloc::register_device_memory(*m_context, m_device_id, device_ptr, a.size),
+                device_ptr, m_device_id, m_block_size);
             set_device_id(tmp);
+            return s;
         }
-        else
 #endif
+        return std::make_unique<segment_type>(this,
+            hwmalloc::register_memory(*m_context, a.ptr, a.size), a, m_block_size);
+    }
+
+    // fault in the pages of a new segment in prefault mode, such that the first touch of its
+    // blocks does not happen on the allocating threads
+    std::unique_ptr<segment_type> populate(std::unique_ptr<segment_type> s) noexcept
+    {
+        if (m_config.m_prefault) s->populate_pages();
+        return s;
+    }
+
+    // make a new segment available to the allocating threads, m_mutex is locked: up to n of its
+    // blocks are written to out first, in eager mode the others are pushed to the free stack at
+    // once. Returns the number of blocks written to out.
+    template<typename OutputIterator>
+    std::size_t adopt_segment(std::unique_ptr<segment_type> s, std::size_t n, OutputIterator& out)
+    {
+        auto ptr = s.get();
+        m_segments[ptr] = std::move(s);
+        n = std::min(n, ptr->num_uncarved());
+        out = ptr->carve(n, out);
+        if (m_config.m_lazy_carving) m_carve_segment = ptr;
+        else
+            ptr->carve_all(m_free_stack);
+        return n;
+    }
+
+    void adopt_segment(std::unique_ptr<segment_type> s)
+    {
+        block_type* none = nullptr;
+        adopt_segment(std::move(s), 0u, none);
+    }
+
+    // returns a spare segment if there is one and asks for more below the low watermark
+    std::unique_ptr<segment_type> take_spare_segment()
+    {
+        if (!m_config.m_provisioner) return {};
+        std::unique_ptr<segment_type> s;
+        std::size_t                   num_spare = 0u;
         {
-            auto s = std::make_unique<segment_type>(this,
-                hwmalloc::register_memory(*m_context, a.ptr, a.size), a, m_block_size,
-                m_free_stack);
-            m_segments[s.get()] = std::move(s);
+            std::lock_guard<std::mutex> lock(m_spare_mutex);
+            if (!m_spare_segments.empty())
+            {
+                s = std::move(m_spare_segments.back());
+                m_spare_segments.pop_back();
+            }
+            num_spare = m_spare_segments.size();
         }
+        if (num_spare < m_config.m_provision_low_watermark && !m_provisioning.exchange(true))
+            m_config.m_provisioner->request(this, [this]() { provision(); });
+        return s;
+    }
+
+    // runs on the provisioner thread: build spare segments up to the high watermark
+    void provision()
+    {
+        try
+        {
+            while (num_spare_segments() < m_config.m_provision_high_watermark)
+            {
+                auto s = make_segment();
+                std::lock_guard<std::mutex> lock(m_spare_mutex);
+                m_spare_segments.push_back(std::move(s));
+            }
+        }
+        catch (...)
+        {
+            // out of memory: the allocating threads will report the error when they try to
+            // build the segment themselves
+        }
+        m_provisioning.store(false);
+    }
+
+    // move the next batch (one page worth of blocks) of the current lazy segment to the free
+    // stack, returns false if there is nothing left to carve, m_mutex is locked
+    bool carve()
+    {
+        if (!m_carve_segment || m_carve_segment->num_uncarved() == 0u) return false;
+        const auto n = std::max<std::size_t>(numa().page_size() / m_block_size, 1u);
+        m_carve_buffer.clear();
+        m_carve_segment->carve(n, std::back_inserter(m_carve_buffer));
+        // push in reverse order such that blocks are popped in address order
+        flush(m_carve_buffer.rbegin(), m_carve_buffer.rend());
+        return true;
     }
 
   public:
     pool(Context* context, std::size_t block_size, std::size_t segment_size, std::size_t numa_node,
-        bool never_free, std::size_t num_reserve_segments)
+        bool never_free, std::size_t num_reserve_segments, pool_config const& config = {},
+        arena_heap_type* arenas = nullptr)
     : m_context{context}
     , m_block_size{block_size}
     , m_segment_size{segment_size}
     , m_numa_node{numa_node}
     , m_never_free{never_free}
     , m_num_reserve_segments{std::max(num_reserve_segments, 1ul)}
+    , m_config{config}
+    , m_arenas{arenas}
     , m_free_stack(segment_size / block_size)
+    , m_pending_segments(m_num_reserve_segments)
     {
+        if (m_config.m_thread_cache_size > 0u)
+            m_cache_id = thread_cache_registry_type::acquire_id();
     }
 
 #if HWMALLOC_ENABLE_DEVICE
     pool(Context* context, std::size_t block_size, std::size_t segment_size, std::size_t numa_node,
-        int device_id, bool never_free, std::size_t num_reserve_segments)
-    : pool(context, block_size, segment_size, numa_node, never_free, num_reserve_segments)
+        int device_id, bool never_free, std::size_t num_reserve_segments,
+        pool_config const& config = {})
+    : pool(context, block_size, segment_size, numa_node, never_free, num_reserve_segments, config)
     {
         m_device_id = device_id;
         m_allocate_on_device = true;
     }
 #endif
 
-    auto allocate()
+    pool(pool const&) = delete;
+    pool(pool&&) = delete;
+
+    ~pool()
+    {
+        if (m_config.m_provisioner) m_config.m_provisioner->cancel(this);
+        if (m_config.m_thread_cache_size > 0u)
+        {
+            // blocks still held by thread caches point into segments which are about to be
+            // destroyed: drop them and detach the caches
+            std::lock_guard<std::mutex> lock(thread_cache_registry_type::mutex());
+            for (auto c : m_caches) c->m_owner->drop(c);
+            thread_cache_registry_type::release_id(m_cache_id);
+        }
+        if (m_config.m_budget)
+            m_config.m_budget->release(m_numa_node,
+                (m_segments.size() + m_spare_segments.size()) * segment_bytes());
+    }
+
+    std::size_t block_size() const noexcept { return m_block_size; }
+    std::size_t thread_cache_size() const noexcept { return m_config.m_thread_cache_size; }
+    bool        page_mapped() const noexcept { return m_config.m_page_map; }
+    void const* owner() const noexcept { return m_config.m_owner; }
+
+    // number of blocks held by the calling thread's cache
+    std::size_t num_thread_cached_blocks()
+    {
+        return cached() ? thread_cache_set_type::instance().size(this, m_cache_id) : 0u;
+    }
+
+    // release all parked empty segments beyond the reserve (or their pages in madvise mode) right
+    // away
+    void purge()
+    {
+        if (m_never_free) return;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        decay(true);
+    }
+
+    pool_stats stats()
+    {
+        pool_stats res;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            res.m_num_segments = m_segments.size();
+            for (auto const& kvp : m_segments)
+                res.m_registered_bytes += kvp.first->allocation_size();
+            res.m_resident_bytes = res.m_registered_bytes - m_released_bytes;
+        }
+        std::lock_guard<std::mutex> lock(m_spare_mutex);
+        for (auto const& s : m_spare_segments)
+        {
+            ++res.m_num_segments;
+            res.m_registered_bytes += s->allocation_size();
+            res.m_resident_bytes += s->allocation_size();
+        }
+        return res;
+    }
+
+    std::size_t num_segments()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_segments.size();
+    }
+
+    std::size_t num_spare_segments()
+    {
+        std::lock_guard<std::mutex> lock(m_spare_mutex);
+        return m_spare_segments.size();
+    }
+
+    block_type allocate()
+    {
+        if (cached())
+            return thread_cache_set_type::instance().allocate(this, m_cache_id,
+                m_config.m_thread_cache_max_bytes);
+        return allocate_uncached();
+    }
+
+    void free(block_type const& b)
+    {
+        b.m_segment->mark_recycled();
+        if (cached() && thread_cache_set_type::instance().free(this, m_cache_id,
+                            m_config.m_thread_cache_max_bytes, b))
+            return;
+        free_uncached(b);
+    }
+
+    // write count blocks to out: the blocks on the free stack are popped one by one (the lock-free
+    // stack has no bounded chain pop), the remainder is taken under a single lock, see
+    // allocate_bulk_uncached
+    template<typename OutputIterator>
+    OutputIterator allocate_bulk(std::size_t count, OutputIterator out)
+    {
+        if (cached())
+        {
+            auto& caches = thread_cache_set_type::instance();
+            for (std::size_t i = 0; i < count; ++i)
+                *out++ = caches.allocate(this, m_cache_id, m_config.m_thread_cache_max_bytes);
+            return out;
+        }
+        block_type b;
+        while (count > 0 && m_free_stack.pop(b))
+        {
+            *out++ = b;
+            --count;
+        }
+        if (count > 0) allocate_bulk_uncached(count, out);
+        return out;
+    }
+
+    // free a range of blocks which were all allocated from this pool: consecutive blocks from the
+    // same segment are returned to it in a single operation
+    template<typename Iterator>
+    void free_bulk(Iterator first, Iterator last)
+    {
+        if (cached())
+        {
+            for (; first != last; ++first) free(*first);
+            return;
+        }
+        while (first != last)
+        {
+            auto s = first->m_segment;
+            auto run_end =
+                std::find_if(first, last, [s](block_type const& b) { return b.m_segment != s; });
+            s->mark_recycled();
+            if (s->free_bulk(first, run_end)) release_if_empty(s);
+            first = run_end;
+        }
+    }
+
+    // append up to n blocks to v (at least one)
+    template<typename Vector>
+    void refill(Vector& v, std::size_t n)
+    {
+        v.push_back(allocate_uncached());
+        block_type b;
+        for (std::size_t i = 1; i < n && m_free_stack.pop(b); ++i) v.push_back(b);
+    }
+
+    // return blocks from a thread cache to the free stack
+    template<typename Iterator>
+    void flush(Iterator first, Iterator last)
+    {
+        while (first != last) first = m_free_stack.push(first, last);
+    }
+
+    // called by a segment on the first free after it was collected
+    void enqueue_pending(segment_type* s)
+    {
+        while (!m_pending_segments.push(s)) {}
+    }
+
+    // called with the thread_cache_registry mutex locked
+    void attach_cache(thread_cache_type* c) { m_caches.push_back(c); }
+
+    // called on thread exit with the thread_cache_registry mutex locked
+    void detach_cache(thread_cache_type* c)
+    {
+        for (auto const& b : c->m_blocks) free_uncached(b);
+        c->m_blocks.clear();
+        c->m_pool.store(nullptr, std::memory_order_relaxed);
+        m_caches.erase(std::find(m_caches.begin(), m_caches.end(), c));
+    }
+
+  private:
+    // blocks larger than the per-thread byte limit bypass the caches
+    bool cached() const noexcept
+    {
+        return m_config.m_thread_cache_size > 0u &&
+               m_block_size <= m_config.m_thread_cache_max_bytes;
+    }
+
+    block_type allocate_uncached()
     {
         block_type b;
         if (m_free_stack.pop(b)) return b;
-        m_mutex.lock();
-        if (m_free_stack.pop(b))
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_parked_segments.empty()) decay(false);
+        while (true)
+        {
+            if (m_free_stack.pop(b)) return b;
+            // only segments with freed blocks need to be visited, parked segments are left alone
+            // so that they can decay
+            m_pending_segments.consume_all(
+                [this](segment_type* s)
+                {
+                    if (!m_parked_segments.count(s)) s->collect(m_free_stack);
+                });
+            if (m_free_stack.pop(b)) return b;
+            if (m_config.m_lazy_carving && carve()) continue;
+            if (unpark()) continue;
+            if (m_growing)
+            {
+                // another thread is building a segment: wait for it instead of building one too
+                m_grow_cv.wait(lock, [this]() { return !m_growing; });
+                continue;
+            }
+            if (auto spare = take_spare_segment())
+            {
+                adopt_segment(std::move(spare));
+                continue;
+            }
+            grow(lock);
+        }
+    }
+
+    // build a new segment with m_mutex released, the lock is held again on return
+    // take count blocks with m_mutex locked once: the freed blocks of pending segments and the
+    // blocks of the current lazy segment or of new segments are written to out directly instead
+    // of passing through the free stack
+    template<typename OutputIterator>
+    void allocate_bulk_uncached(std::size_t count, OutputIterator& out)
+    {
+        // the blocks pass through an iterator which can be copied and assigned
+        auto put = [&out](block_type const& b) { *out++ = b; };
+        auto sink = boost::make_function_output_iterator(std::ref(put));
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_parked_segments.empty()) decay(false);
+        block_type b;
+        while (true)
+        {
+            while (count > 0 && m_free_stack.pop(b))
+            {
+                *sink++ = b;
+                --count;
+            }
+            if (count == 0) return;
+            m_pending_segments.consume_all(
+                [this, &count, &sink](segment_type* s)
+                {
+                    if (!m_parked_segments.count(s))
+                        count -= s->collect(count, sink, m_free_stack);
+                });
+            if (count == 0) return;
+            if (m_config.m_lazy_carving && m_carve_segment && m_carve_segment->num_uncarved() > 0)
+            {
+                const auto n = std::min(count, m_carve_segment->num_uncarved());
+                sink = m_carve_segment->carve(n, sink);
+                count -= n;
+                continue;
+            }
+            if (unpark()) continue;
+            if (m_growing)
+            {
+                m_grow_cv.wait(lock, [this]() { return !m_growing; });
+                continue;
+            }
+            if (auto spare = take_spare_segment())
+            {
+                count -= adopt_segment(std::move(spare), count, sink);
+                continue;
+            }
+            count -= grow(lock, count, sink);
+        }
+    }
+
+    void grow(std::unique_lock<std::mutex>& lock)
+    {
+        block_type* none = nullptr;
+        grow(lock, 0u, none);
+    }
+
+    // build a new segment outside of m_mutex and adopt it, see adopt_segment
+    template<typename OutputIterator>
+    std::size_t grow(std::unique_lock<std::mutex>& lock, std::size_t n, OutputIterator& out)
+    {
+        m_growing = true;
+        lock.unlock();
+        std::unique_ptr<segment_type> s;
+        try
         {
-            m_mutex.unlock();
-            return b;
+            s = make_segment();
         }
-        for (auto& kvp : m_segments) kvp.first->collect(m_free_stack);
-        if (m_free_stack.pop(b))
+        catch (...)
         {
-            m_mutex.unlock();
-            return b;
+            lock.lock();
+            m_growing = false;
+            m_grow_cv.notify_all();
+            throw;
         }
-        unsigned int counter = 0;
-        while (!m_free_stack.pop(b))
+        lock.lock();
+        n = adopt_segment(std::move(s), n, out);
+        m_growing = false;
+        m_grow_cv.notify_all();
+        return n;
+    }
+
+    void free_uncached(block_type const& b)
+    {
+        if (b.m_segment->free(b)) release_if_empty(b.m_segment);
+    }
+
+    // drop a segment which is about to be destroyed from the pending list, m_mutex is locked
+    void remove_pending(segment_type* s)
+    {
+        std::vector<segment_type*> others;
+        m_pending_segments.consume_all(
+            [s, &others](segment_type* x)
+            {
+                if (x != s) others.push_back(x);
+            });
+        for (auto x : others)
+            while (!m_pending_segments.push(x)) {}
+    }
+
+    // destroy a segment, m_mutex is locked
+    void erase_segment(segment_type* s)
+    {
+        remove_pending(s);
+#if HWMALLOC_ENABLE_DEVICE
+        if (m_allocate_on_device)
         {
-            // add segments every 2nd iteration
-            if (counter++ % 2 == 0) add_segment();
+            const auto tmp = get_device_id();
+            set_device_id(m_device_id);
+            m_segments.erase(s);
+            set_device_id(tmp);
         }
-        m_mutex.unlock();
-        return b;
+        else
+#endif
+            m_segments.erase(s);
+        if (m_config.m_budget) m_config.m_budget->release(m_numa_node, segment_bytes());
     }
 
-    void free(block_type const& b)
+    // reuse the most recently parked segment, m_mutex is locked
+    bool unpark()
+    {
+        if (m_parked_segments.empty()) return false;
+        auto newest = m_parked_segments.begin();
+        for (auto it = m_parked_segments.begin(); it != m_parked_segments.end(); ++it)
+            if (it->second.m_time > newest->second.m_time) newest = it;
+        auto s = newest->first;
+        m_released_bytes -= newest->second.m_released_bytes;
+        if (newest->second.m_released_bytes > 0u) --m_num_released_segments;
+        m_parked_segments.erase(newest);
+        s->collect(m_free_stack);
+        return true;
+    }
+
+    // release parked segments which stayed empty for longer than the decay time (or all of them
+    // if force is set), m_mutex is locked: in madvise mode only their pages are released, and the
+    // reserve is made of the segments which still hold their pages
+    void decay(bool force)
+    {
+        const auto now = clock_type::now();
+        const auto decay_time = std::chrono::milliseconds(m_config.m_segment_decay_ms);
+        for (auto it = m_parked_segments.begin(); it != m_parked_segments.end();)
+        {
+            auto  s = it->first;
+            auto& p = it->second;
+            if (m_segments.size() - m_num_released_segments > m_num_reserve_segments &&
+                (force || now - p.m_time >= decay_time))
+            {
+                if (m_config.m_madvise)
+                {
+                    if (p.m_released_bytes == 0u)
+                    {
+                        p.m_released_bytes = s->release_pages();
+                        m_released_bytes += p.m_released_bytes;
+                        if (p.m_released_bytes > 0u) ++m_num_released_segments;
+                    }
+                    ++it;
+                    continue;
+                }
+                it = m_parked_segments.erase(it);
+                erase_segment(s);
+            }
+            else
+                ++it;
+        }
+    }
+
+    // called after s became empty: s may have been refilled and destroyed by another thread in
+    // the meantime, therefore it is only dereferenced if it is still owned by this pool
+    void release_if_empty(segment_type* s)
     {
-        b.m_segment->free(b);
-        if (!m_never_free && b.m_segment->is_empty())
+        if (!m_never_free)
         {
             std::lock_guard<std::mutex> lock(m_mutex);
-            if (b.m_segment->is_empty() && m_segments.size() > m_num_reserve_segments)
+            // the segment which is currently carved is kept
+            if (m_segments.size() > m_num_reserve_segments && s != m_carve_segment &&
+                m_segments.count(s) && s->is_empty())
             {
-#if HWMALLOC_ENABLE_DEVICE
-                if (m_allocate_on_device)
+                if (m_config.m_segment_decay_ms == 0u && !m_config.m_madvise)
                 {
-                    const auto tmp = get_device_id();
-                    set_device_id(m_device_id);
-                    m_segments.erase(b.m_segment);
-                    set_device_id(tmp);
+                    erase_segment(s);
+                    return;
                 }
-                else
-#endif
-                    m_segments.erase(b.m_segment);
+                // park the segment: it stays available but is only reused when there is nothing
+                // else left
+                m_parked_segments[s] = parked_segment{clock_type::now()};
+            }
+            if (!m_parked_segments.empty())
+            {
+                decay(false);
+                schedule_decay();
             }
         }
     }
+
+    // ask the worker thread to decay the oldest parked segment which can still be released once
+    // its time has come, such that idle pools return their memory as well, m_mutex is locked
+    void schedule_decay()
+    {
+        if (!m_config.m_provisioner || m_decay_scheduled) return;
+        if (m_segments.size() - m_num_released_segments <= m_num_reserve_segments) return;
+        std::optional<clock_type::time_point> oldest;
+        for (auto const& kvp : m_parked_segments)
+            if (kvp.second.m_released_bytes == 0u && (!oldest || kvp.second.m_time < *oldest))
+                oldest = kvp.second.m_time;
+        if (!oldest) return;
+        const auto decay_time = std::chrono::milliseconds(m_config.m_segment_decay_ms);
+        // a segment whose pages could not be released is retried after another decay time
+        auto deadline = *oldest + decay_time;
+        if (deadline <= clock_type::now()) deadline = clock_type::now() + decay_time;
+        m_decay_scheduled = true;
+        m_config.m_provisioner->request_at(this, deadline,
+            [this]()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_decay_scheduled = false;
+                decay(false);
+                schedule_decay();
+            });
+    }
 };
 
 } // namespace detail
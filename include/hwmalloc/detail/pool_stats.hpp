@@ -0,0 +1,35 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// Memory held by a pool: resident bytes exclude pages which were released with madvise.
+struct pool_stats
+{
+    std::size_t m_num_segments = 0u;
+    std::size_t m_registered_bytes = 0u;
+    std::size_t m_resident_bytes = 0u;
+
+    pool_stats& operator+=(pool_stats const& other) noexcept
+    {
+        m_num_segments += other.m_num_segments;
+        m_registered_bytes += other.m_registered_bytes;
+        m_resident_bytes += other.m_resident_bytes;
+        return *this;
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -0,0 +1,145 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// Background worker which builds (allocates and registers) segments ahead of time on behalf of
+// pools, and runs their timed tasks (the decay of empty segments). Tasks are tagged with their
+// owner so that a pool can withdraw its pending requests and wait for a running one to finish
+// before it is destroyed.
+class provisioner
+{
+  public:
+    using clock_type = std::chrono::steady_clock;
+
+  private:
+    using task = std::pair<void const*, std::function<void()>>;
+
+    std::mutex                                 m_mutex;
+    std::condition_variable                    m_cv;
+    std::deque<task>                           m_tasks;
+    std::multimap<clock_type::time_point, task> m_timers;
+    void const*                                m_current = nullptr;
+    bool                                       m_stop = false;
+    std::thread                                m_thread;
+
+  public:
+    provisioner()
+    : m_thread{[this]() { run(); }}
+    {
+    }
+
+    provisioner(provisioner const&) = delete;
+    provisioner(provisioner&&) = delete;
+
+    ~provisioner() { stop(); }
+
+    // wait for a running task and drop the pending ones: later requests are never executed
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            m_tasks.clear();
+            m_timers.clear();
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    void request(void const* owner, std::function<void()> f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop) return;
+            m_tasks.emplace_back(owner, std::move(f));
+        }
+        m_cv.notify_all();
+    }
+
+    // run f once the deadline has passed, after the tasks requested without a deadline
+    void request_at(void const* owner, clock_type::time_point deadline, std::function<void()> f)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop) return;
+            m_timers.emplace(deadline, task{owner, std::move(f)});
+        }
+        m_cv.notify_all();
+    }
+
+    // drop all pending tasks of owner and wait until a running one has finished
+    void cancel(void const* owner)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_tasks.erase(std::remove_if(m_tasks.begin(), m_tasks.end(),
+                          [owner](task const& t) { return t.first == owner; }),
+            m_tasks.end());
+        for (auto it = m_timers.begin(); it != m_timers.end();)
+        {
+            if (it->second.first == owner) it = m_timers.erase(it);
+            else
+                ++it;
+        }
+        m_cv.wait(lock, [this, owner]() { return m_current != owner; });
+    }
+
+  private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_cv.wait(lock, [this]() { return m_stop || !m_tasks.empty() || !m_timers.empty(); });
+            if (m_stop) return;
+            task t;
+            if (!m_tasks.empty())
+            {
+                t = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            else
+            {
+                // wake up at the first deadline or when a new task arrives
+                auto       first = m_timers.begin();
+                const auto deadline = first->first;
+                if (clock_type::now() < deadline)
+                {
+                    m_cv.wait_until(lock, deadline);
+                    continue;
+                }
+                t = std::move(first->second);
+                m_timers.erase(first);
+            }
+            m_current = t.first;
+            lock.unlock();
+            t.second();
+            lock.lock();
+            m_current = nullptr;
+            m_cv.notify_all();
+        }
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
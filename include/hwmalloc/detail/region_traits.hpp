@@ -37,6 +37,8 @@ struct region_traits
         std::is_copy_constructible<handle_type>::value, "handle is not copy constructible");
     static_assert(std::is_copy_assignable<handle_type>::value, "handle is not copy assignable");
 
+    static constexpr bool lazy_handles = hwmalloc::lazy_handles<Context>::value;
+
 #if HWMALLOC_ENABLE_DEVICE
     using device_region_type =
         decltype(hwmalloc::register_device_memory(*((Context*)0), int(0), nullptr, 0u));
@@ -0,0 +1,209 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/detail/region_traits.hpp>
+#include <hwmalloc/numa.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// Cache of the registrations of user allocations. Registered ranges are rounded to pages and kept
+// disjoint in a map ordered by address, so that the range covering a request is found with a
+// single search. A request which is not covered by one range is registered anew, spanning the
+// union of all ranges it overlaps; these are dropped from the cache and deregistered once their
+// last user is gone. Ranges are reference counted: unused ones stay registered for reuse and are
+// evicted in least recently used order when the registered bytes exceed the limit (ranges in use
+// are never evicted, the limit may therefore be exceeded temporarily). Ranges which were dropped
+// from the cache while in use count towards the limit until they are deregistered. Memory which is
+// returned to the system must be invalidated first, otherwise a later allocation at the same
+// address would hit a stale registration.
+template<typename Context>
+class registration_cache
+{
+  public:
+    using region_type = typename region_traits<Context>::region_type;
+    using handle_type = typename region_traits<Context>::handle_type;
+
+    struct entry
+    {
+        char*       m_begin;
+        std::size_t m_size;
+        region_type m_region;
+        std::size_t m_refs = 1u;
+        // false once the entry was evicted, invalidated or merged: it is deleted with the last
+        // reference
+        bool        m_cached = true;
+        // neighbours in the list of unused entries, valid if cached and not referenced
+        entry*      m_lru_prev = nullptr;
+        entry*      m_lru_next = nullptr;
+
+        char* end() const noexcept { return m_begin + m_size; }
+
+        handle_type get_handle(void const* ptr, std::size_t size) const noexcept
+        {
+            return m_region.get_handle((char const*)ptr - m_begin, size);
+        }
+    };
+
+  private:
+    using entry_map = std::map<char*, entry*>;
+
+    Context*    m_context;
+    std::size_t m_limit;
+    std::mutex  m_mutex;
+    entry_map   m_entries; // cached entries by start address, disjoint
+    // intrusive list of cached entries without references, most recently used first
+    entry*      m_unused_head = nullptr;
+    entry*      m_unused_tail = nullptr;
+    std::size_t m_bytes = 0u;
+
+  public:
+    // a limit of 0 means unlimited
+    registration_cache(Context* context, std::size_t limit)
+    : m_context{context}
+    , m_limit{limit}
+    {
+    }
+
+    registration_cache(registration_cache const&) = delete;
+    registration_cache(registration_cache&&) = delete;
+
+    ~registration_cache()
+    {
+        for (auto& kvp : m_entries) delete kvp.second;
+    }
+
+    // registered bytes held by the cache, including dropped ranges which are still in use
+    std::size_t registered_bytes()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_bytes;
+    }
+
+    // number of cached registrations
+    std::size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    // a registration covering [ptr, ptr + size), must be released
+    entry* acquire(void* ptr, std::size_t size)
+    {
+        const auto page_size = numa().page_size();
+        auto       first = (std::uintptr_t)ptr / page_size * page_size;
+        auto       last = ((std::uintptr_t)ptr + std::max<std::size_t>(size, 1u) + page_size - 1) /
+                    page_size * page_size;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto                        it = m_entries.upper_bound((char*)first);
+        if (it != m_entries.begin() && std::prev(it)->second->end() > (char*)first) --it;
+        if (it != m_entries.end() && it->first <= (char*)first &&
+            it->second->end() >= (char*)last)
+        {
+            auto e = it->second;
+            if (e->m_refs++ == 0u) unlink(e);
+            return e;
+        }
+
+        // merge with all overlapping ranges
+        while (it != m_entries.end() && it->first < (char*)last)
+        {
+            first = std::min(first, (std::uintptr_t)it->first);
+            last = std::max(last, (std::uintptr_t)it->second->end());
+            it = remove(it);
+        }
+        evict(last - first);
+        auto e = new entry{(char*)first, last - first,
+            hwmalloc::register_memory(*m_context, (void*)first, last - first)};
+        m_entries.emplace(e->m_begin, e);
+        m_bytes += e->m_size;
+        return e;
+    }
+
+    void release(entry* e) noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--e->m_refs > 0u) return;
+        if (!e->m_cached)
+        {
+            m_bytes -= e->m_size;
+            delete e;
+            return;
+        }
+        link_front(e);
+        evict(0u);
+    }
+
+    // drop all registrations overlapping [ptr, ptr + size): to be called before the memory is
+    // returned to the system
+    void invalidate(void* ptr, std::size_t size) noexcept
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto                        it = m_entries.upper_bound((char*)ptr);
+        if (it != m_entries.begin() && std::prev(it)->second->end() > (char*)ptr) --it;
+        while (it != m_entries.end() && it->first < (char*)ptr + size) it = remove(it);
+    }
+
+  private:
+    // remove an entry from the cache, m_mutex is locked; an entry in use keeps its bytes until it
+    // is released
+    typename entry_map::iterator remove(typename entry_map::iterator it) noexcept
+    {
+        auto e = it->second;
+        e->m_cached = false;
+        if (e->m_refs == 0u)
+        {
+            unlink(e);
+            m_bytes -= e->m_size;
+            delete e;
+        }
+        return m_entries.erase(it);
+    }
+
+    void link_front(entry* e) noexcept
+    {
+        e->m_lru_prev = nullptr;
+        e->m_lru_next = m_unused_head;
+        if (m_unused_head) m_unused_head->m_lru_prev = e;
+        else
+            m_unused_tail = e;
+        m_unused_head = e;
+    }
+
+    void unlink(entry* e) noexcept
+    {
+        if (e->m_lru_prev) e->m_lru_prev->m_lru_next = e->m_lru_next;
+        else
+            m_unused_head = e->m_lru_next;
+        if (e->m_lru_next) e->m_lru_next->m_lru_prev = e->m_lru_prev;
+        else
+            m_unused_tail = e->m_lru_prev;
+        e->m_lru_prev = e->m_lru_next = nullptr;
+    }
+
+    // evict unused entries until bytes more fit below the limit, m_mutex is locked
+    void evict(std::size_t bytes) noexcept
+    {
+        if (m_limit == 0u) return;
+        while (m_bytes + bytes > m_limit && m_unused_tail)
+            remove(m_entries.find(m_unused_tail->m_begin));
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
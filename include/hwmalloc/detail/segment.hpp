@@ -10,13 +10,18 @@
 #pragma once
 
 #include <hwmalloc/detail/block.hpp>
+#include <hwmalloc/detail/page_map.hpp>
+#include <hwmalloc/detail/extent_heap.hpp>
 #include <hwmalloc/numa.hpp>
 #if HWMALLOC_ENABLE_DEVICE
 #include <hwmalloc/device.hpp>
 #endif
 #include <type_traits>
 #include <boost/lockfree/stack.hpp>
+#include <algorithm>
 #include <atomic>
+#include <iterator>
+#include <optional>
 
 namespace hwmalloc
 {
@@ -36,11 +41,17 @@ class segment
     using device_region_type = typename region_traits_type::device_region_type;
 #endif
     using block = block_t<Context>;
+    using extent_type = extent<Context>;
 
     struct allocation_holder
     {
         numa_tools::allocation m;
-        ~allocation_holder() noexcept { hwmalloc::numa().free(m); }
+        // false if the memory belongs to an arena
+        bool m_owned = true;
+        ~allocation_holder() noexcept
+        {
+            if (m_owned) hwmalloc::numa().free(m);
+        }
     };
 
 #if HWMALLOC_ENABLE_DEVICE
@@ -55,85 +66,167 @@ class segment
 #endif
 
   private:
-    using stack_type = boost::lockfree::stack<block, boost::lockfree::fixed_sized<true>>;
+    // Note: the node pool is preallocated for all blocks and never grows. The stack is not declared
+    // fixed_sized since that limits the capacity to 2^16 nodes and does not support range pushes.
+    using stack_type = boost::lockfree::stack<block>;
 
+    // Layout: the read-mostly fields come first, followed by the state written by freeing
+    // threads (stack and counters, on separate cache lines) and by the allocating side (carving),
+    // such that freeing into another thread's segment does not invalidate the lines it reads.
     pool_type*        m_pool;
     std::size_t       m_block_size;
     std::size_t       m_num_blocks;
     allocation_holder m_allocation;
-    region_type       m_region;
+    // own registration, or the extent of an arena which provides memory and registration
+    std::optional<region_type> m_region;
+    extent_type*               m_extent = nullptr;
+    // the memory was zero-filled when the segment was created
+    bool m_zeroed;
+    // set before the first block is returned: from then on blocks may be handed out again
+    std::atomic<bool> m_recycled{false};
+    // the pages are entered in the page map
+    bool m_mapped = false;
 #if HWMALLOC_ENABLE_DEVICE
     device_allocation_holder            m_device_allocation;
     std::unique_ptr<device_region_type> m_device_region;
+    int                                 m_device_id = 0;
 #endif
-    stack_type        m_freed_stack;
-    std::atomic<long> m_num_freed;
+    alignas(64) stack_type m_freed_stack;
+    // blocks which have not been carved yet are counted as freed
+    alignas(64) std::atomic<long> m_num_freed;
+    // set while the segment is queued in its pool's list of segments with freed blocks
+    std::atomic<bool> m_pending{false};
+    // number of blocks handed out from the untouched part of the segment (guarded by the pool's
+    // mutex)
+    alignas(64) std::size_t m_num_carved;
 
   public:
-    template<typename Stack>
+    // blocks are handed out through carve: on demand with lazy carving, all at once otherwise
     segment(pool_type* pool, region_type&& region, numa_tools::allocation alloc,
-        std::size_t block_size, Stack& free_stack)
+        std::size_t block_size)
     : m_pool{pool}
     , m_block_size{block_size}
     , m_num_blocks{alloc.size / block_size}
     , m_allocation{alloc}
     , m_region{std::move(region)}
+    , m_zeroed{alloc.zeroed}
     , m_freed_stack(m_num_blocks)
-    , m_num_freed(0)
+    , m_num_freed(m_num_blocks)
+    , m_num_carved(0u)
     {
-        char* origin = (char*)m_allocation.m.ptr;
-        for (std::size_t i = m_num_blocks; i > 0; --i)
-        {
-            block b{this, nullptr, origin + (i - 1) * block_size,
-                m_region.get_handle((i - 1) * block_size, block_size)};
-            while (!free_stack.push(b)) {}
-        }
+        register_pages();
+    }
+
+    // segment carved from an arena: the extent is returned to its pool on destruction
+    segment(pool_type* pool, extent_type* e, std::size_t block_size)
+    : m_pool{pool}
+    , m_block_size{block_size}
+    , m_num_blocks{e->m_size / block_size}
+    , m_allocation{{e->m_ptr, e->m_size, e->m_pool->numa_node()}, false}
+    , m_extent{e}
+    , m_zeroed{e->m_fresh}
+    , m_freed_stack(m_num_blocks)
+    , m_num_freed(m_num_blocks)
+    , m_num_carved(0u)
+    {
+        register_pages();
     }
 
 #if HWMALLOC_ENABLE_DEVICE
-    template<typename Stack>
+    // device segment, see above
     segment(pool_type* pool, region_type&& region, numa_tools::allocation alloc,
-        device_region_type&& device_region, void* device_ptr, int device_id, std::size_t block_size,
-        Stack& free_stack)
+        device_region_type&& device_region, void* device_ptr, int device_id, std::size_t block_size)
     : m_pool{pool}
     , m_block_size{block_size}
     , m_num_blocks{alloc.size / block_size}
     , m_allocation{alloc}
     , m_region{std::move(region)}
+    , m_zeroed{alloc.zeroed}
     , m_device_allocation{device_ptr}
     , m_device_region{new device_region_type(std::move(device_region))}
+    , m_device_id{device_id}
     , m_freed_stack(m_num_blocks)
-    , m_num_freed(0)
+    , m_num_freed(m_num_blocks)
+    , m_num_carved(0u)
     {
-        char* origin = (char*)m_allocation.m.ptr;
-        char* device_origin = (char*)m_device_allocation.m;
-        for (std::size_t i = m_num_blocks; i > 0; --i)
-        {
-            block b{this, nullptr, origin + (i - 1) * block_size,
-                m_region.get_handle((i - 1) * block_size, block_size),
-                device_origin + (i - 1) * block_size,
-                m_device_region->get_handle((i - 1) * block_size, block_size), device_id};
-            while (!free_stack.push(b)) {}
-        }
+        register_pages();
     }
 #endif
 
     segment(segment const&) = delete;
     segment(segment&&) = delete;
 
+    ~segment()
+    {
+        if (m_mapped) page_map<Context>::instance().erase(m_allocation.m.ptr, m_allocation.m.size);
+        if (m_extent) m_extent->m_pool->free(m_extent);
+    }
+
     std::size_t block_size() const noexcept { return m_block_size; }
     std::size_t capacity() const noexcept { return m_num_blocks; }
     std::size_t numa_node() const noexcept { return m_allocation.m.node; }
     pool_type*  get_pool() const noexcept { return m_pool; }
+    std::size_t num_uncarved() const noexcept { return m_num_blocks - m_num_carved; }
+    std::size_t allocation_size() const noexcept { return m_allocation.m.size; }
+
+    // return the host pages to the OS, the memory stays mapped and registered
+    std::size_t release_pages() noexcept
+    {
+        return numa().release_pages(m_allocation.m.ptr, m_allocation.m.size,
+            m_allocation.m.page_size);
+    }
+
+    // true as long as no block was returned: the blocks handed out so far are on zero-filled
+    // pages which have not been written by a previous owner
+    bool fresh() const noexcept { return m_zeroed && !m_recycled.load(std::memory_order_relaxed); }
+
+    // to be called when a block is returned, before it can be handed out again
+    void mark_recycled() noexcept
+    {
+        if (!m_recycled.load(std::memory_order_relaxed))
+            m_recycled.store(true, std::memory_order_relaxed);
+    }
+
+    // fault in the host pages, keeping their content
+    void populate_pages() noexcept
+    {
+        numa().populate_pages(m_allocation.m.ptr, m_allocation.m.size, m_allocation.m.page_size);
+    }
 
     bool is_empty() const noexcept
     {
         return static_cast<std::size_t>(m_num_freed.load()) == m_num_blocks;
     }
 
+    // write up to n blocks from the untouched part of the segment to out, in address order
+    template<typename OutputIterator>
+    OutputIterator carve(std::size_t n, OutputIterator out)
+    {
+        n = std::min(n, num_uncarved());
+        for (std::size_t i = 0; i < n; ++i) *out++ = make_block(m_num_carved + i);
+        m_num_carved += n;
+        m_num_freed.fetch_sub(n);
+        return out;
+    }
+
+    // push all blocks which have not been carved yet to free_stack, such that they are popped in
+    // address order
+    template<typename Stack>
+    void carve_all(Stack& free_stack)
+    {
+        const auto n = num_uncarved();
+        for (std::size_t i = m_num_blocks; i > m_num_carved; --i)
+            while (!free_stack.push(make_block(i - 1))) {}
+        m_num_carved = m_num_blocks;
+        m_num_freed.fetch_sub(n);
+    }
+
+    // move all freed blocks to stack
     template<typename Stack>
     std::size_t collect(Stack& stack)
     {
+        // reset the flag first: blocks freed from now on re-queue the segment
+        m_pending.store(false);
         const auto consumed = m_freed_stack.consume_all(
             [&stack](block const& b)
             {
@@ -143,14 +236,111 @@ class segment
         return consumed;
     }
 
-    void free(block const& b)
+    // move up to n freed blocks to out and the others to stack, returns the number of blocks
+    // written to out: the freed blocks are detached at once
+    template<typename OutputIterator, typename Stack>
+    std::size_t collect(std::size_t n, OutputIterator& out, Stack& stack)
+    {
+        m_pending.store(false);
+        std::size_t taken = 0u;
+        const auto  consumed = m_freed_stack.consume_all_atomic(
+            [n, &taken, &out, &stack](block const& b)
+            {
+                if (taken < n)
+                {
+                    *out++ = b;
+                    ++taken;
+                }
+                else
+                    while (!stack.push(b)) {}
+            });
+        m_num_freed.fetch_sub(consumed);
+        return taken;
+    }
+
+    // Returns true if this call freed the last outstanding block. Note, that the segment may be
+    // destroyed by another thread as soon as the counter is incremented, so it must not be touched
+    // afterwards.
+    bool free(block const& b)
     {
+        const auto num_blocks = m_num_blocks;
         while (!m_freed_stack.push(b)) {}
-        ++m_num_freed;
+        notify_pool();
+        return static_cast<std::size_t>(++m_num_freed) == num_blocks;
+    }
+
+    // return a range of blocks with a single push and a single counter update
+    template<typename Iterator>
+    bool free_bulk(Iterator first, Iterator last)
+    {
+        const auto num_blocks = m_num_blocks;
+        const auto n = std::distance(first, last);
+        while (first != last) first = m_freed_stack.push(first, last);
+        notify_pool();
+        return static_cast<std::size_t>(m_num_freed.fetch_add(n) + n) == num_blocks;
+    }
+
+    // handle of the block which contains ptr
+    typename block::handle_type handle_at(void const* ptr) const noexcept
+    {
+        const auto i = ((char const*)ptr - (char const*)m_allocation.m.ptr) / m_block_size;
+        return get_handle(i * m_block_size, m_block_size);
+    }
+
+    // the block which contains ptr, a null block if ptr lies in the unused tail of the segment
+    block block_at(void const* ptr) noexcept
+    {
+        const auto i = ((char const*)ptr - (char const*)m_allocation.m.ptr) / m_block_size;
+        return i < m_num_blocks ? make_block(i) : block{};
+    }
+
+  private:
+    typename block::handle_type get_handle(std::size_t offset, std::size_t size) const noexcept
+    {
+        if (m_extent) return m_extent->m_arena->get_handle(m_extent->m_ptr + offset, size);
+        return m_region->get_handle(offset, size);
+    }
+
+    // only pools which are configured for the page map enter their segments
+    void register_pages()
+    {
+        if (!m_pool || !m_pool->page_mapped()) return;
+        page_map<Context>::instance().insert(m_allocation.m.ptr, m_allocation.m.size, this);
+        m_mapped = true;
+    }
+
+    // with lazy handles, the handle is not computed here but by block::handle
+    block make_block(std::size_t i)
+    {
+        const auto offset = i * m_block_size;
+        block      b{{}, this, nullptr, (char*)m_allocation.m.ptr + offset};
+        if constexpr (!block::lazy_handles) b.m_handle = get_handle(offset, m_block_size);
+#if HWMALLOC_ENABLE_DEVICE
+        if (m_device_region)
+        {
+            b.m_device_ptr = (char*)m_device_allocation.m + offset;
+            b.m_device_handle = m_device_region->get_handle(offset, m_block_size);
+            b.m_device_id = m_device_id;
+        }
+#endif
+        return b;
+    }
+
+    // the first free after a collect queues the segment in the pool's pending list
+    void notify_pool()
+    {
+        if (m_pool && !m_pending.exchange(true)) m_pool->enqueue_pending(this);
     }
 };
 
 
+template<typename Context>
+typename block_t<Context>::handle_type
+block_t<Context>::handle_from_segment() const noexcept
+{
+    return m_segment->handle_at(m_ptr);
+}
+
 template<typename Context>
 void block_t<Context>::release_from_segment() const noexcept
 {
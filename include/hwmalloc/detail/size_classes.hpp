@@ -0,0 +1,140 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/heap_config.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace hwmalloc
+{
+namespace detail
+{
+// floor(log2(n)) for n > 0
+inline std::size_t
+log2_floor(std::size_t n) noexcept
+{
+    return (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(n);
+}
+
+// Size classes above the tiny limit: every interval (2^k, 2^(k+1)] is split into a fixed number of
+// classes of equal width 2^k / steps. With a single step this gives plain powers of two, with 4
+// steps the classes above 1KiB are 1280, 1536, 1792, 2048, 2560, ... The class of a size is
+// computed in constant time from the position of its leading bit.
+class size_classes
+{
+  private:
+    std::size_t m_min_shift;  // log2 of the tiny limit
+    std::size_t m_step_shift; // log2 of the number of steps per doubling
+
+  public:
+    // steps is rounded down to a power of two and limited such that all block sizes remain
+    // multiples of the tiny increment
+    size_classes(std::size_t tiny_limit, std::size_t steps) noexcept
+    : m_min_shift{log2_floor(tiny_limit)}
+    , m_step_shift{log2_floor(std::max<std::size_t>(
+          std::min(steps, tiny_limit >> heap_config::m_tiny_increment_shift), 1u))}
+    {
+    }
+
+    std::size_t steps() const noexcept { return std::size_t(1) << m_step_shift; }
+
+    // index of the smallest class which holds n bytes, n must be larger than the tiny limit
+    std::size_t index(std::size_t n) const noexcept
+    {
+        const auto k = log2_floor(n - 1); // 2^k < n <= 2^(k+1)
+        const auto j = (n - 1 - (std::size_t(1) << k)) >> (k - m_step_shift);
+        return ((k - m_min_shift) << m_step_shift) + j;
+    }
+
+    std::size_t block_size(std::size_t index) const noexcept
+    {
+        const auto k = m_min_shift + (index >> m_step_shift);
+        const auto j = index & (steps() - 1);
+        return (std::size_t(1) << k) + ((j + 1) << (k - m_step_shift));
+    }
+
+    // block size of the class which holds n bytes
+    std::size_t round_up(std::size_t n) const noexcept { return block_size(index(n)); }
+
+    // number of classes up to and including the one which holds max_size bytes
+    std::size_t num_classes(std::size_t max_size) const noexcept { return index(max_size) + 1; }
+};
+
+// Maps request sizes to a single index over all classes of a heap: the tiny classes (multiples of
+// the tiny increment) come first, followed by the size_classes above the tiny limit. Sizes up to
+// the table limit are resolved with one load from a table built at construction, larger sizes
+// through the leading bit. Size 0 maps to the smallest class.
+class size_class_map
+{
+  private:
+    std::size_t                m_num_tiny;
+    size_classes               m_classes;
+    std::size_t                m_table_limit;
+    std::vector<std::uint16_t> m_table; // class index per tiny increment
+
+  public:
+    // table_limit is raised to at least the tiny limit
+    size_class_map(std::size_t tiny_limit, std::size_t steps, std::size_t table_limit)
+    : m_num_tiny{tiny_limit >> heap_config::m_tiny_increment_shift}
+    , m_classes{tiny_limit, steps}
+    , m_table_limit{std::max(table_limit, tiny_limit)}
+    , m_table(table_index(m_table_limit) + 1)
+    {
+        std::size_t c = 0u;
+        for (std::size_t i = 0; i < m_table.size(); ++i)
+        {
+            const auto n = i << heap_config::m_tiny_increment_shift;
+            while (block_size(c) < n) ++c;
+            m_table[i] = static_cast<std::uint16_t>(c);
+        }
+    }
+
+    std::size_t         num_tiny() const noexcept { return m_num_tiny; }
+    std::size_t         table_limit() const noexcept { return m_table_limit; }
+    size_classes const& classes() const noexcept { return m_classes; }
+
+    // index of the class which holds n bytes if n is at most the tiny limit
+    static constexpr std::size_t tiny_index(std::size_t n) noexcept
+    {
+        return n == 0u ? 0u : table_index(n) - 1;
+    }
+
+    std::size_t index(std::size_t n) const noexcept
+    {
+        if (n <= m_table_limit) return m_table[table_index(n)];
+        return m_num_tiny + m_classes.index(n);
+    }
+
+    std::size_t block_size(std::size_t index) const noexcept
+    {
+        if (index < m_num_tiny) return (index + 1) << heap_config::m_tiny_increment_shift;
+        return m_classes.block_size(index - m_num_tiny);
+    }
+
+    std::size_t round_up(std::size_t n) const noexcept { return block_size(index(n)); }
+
+    // number of classes up to and including the one which holds max_size bytes
+    std::size_t num_classes(std::size_t max_size) const noexcept
+    {
+        return m_num_tiny + m_classes.num_classes(max_size);
+    }
+
+  private:
+    static constexpr std::size_t table_index(std::size_t n) noexcept
+    {
+        return (n + heap_config::m_tiny_increment - 1) >> heap_config::m_tiny_increment_shift;
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -0,0 +1,236 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/detail/block.hpp>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace hwmalloc
+{
+namespace detail
+{
+template<typename Context>
+class pool;
+
+template<typename Context>
+class thread_cache_set;
+
+// Book-keeping shared by all pools and threads of a given Context: hands out the slot indices
+// which pools use to find their cache within a thread's cache set, and serializes attaching and
+// detaching of caches (thread start/exit vs pool construction/destruction).
+template<typename Context>
+struct thread_cache_registry
+{
+    static std::mutex& mutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static std::size_t acquire_id()
+    {
+        std::lock_guard<std::mutex> lock(mutex());
+        auto&                       ids = free_ids();
+        if (ids.empty()) return next_id()++;
+        const auto id = ids.back();
+        ids.pop_back();
+        return id;
+    }
+
+    static void release_id(std::size_t id)
+    {
+        // called with mutex() locked
+        free_ids().push_back(id);
+    }
+
+  private:
+    static std::vector<std::size_t>& free_ids()
+    {
+        static std::vector<std::size_t> ids;
+        return ids;
+    }
+
+    static std::size_t& next_id()
+    {
+        static std::size_t id = 0u;
+        return id;
+    }
+};
+
+// Private LIFO of blocks owned by a single thread in front of a single pool. Blocks are moved
+// to and from the pool in batches. A cache is detached (its pool pointer is reset and its blocks
+// are dropped) when the pool is destroyed before the owning thread exits.
+template<typename Context>
+class thread_cache
+{
+  public:
+    using pool_type = pool<Context>;
+    using block_type = block_t<Context>;
+
+  private:
+    template<typename C>
+    friend class thread_cache_set;
+    friend class pool<Context>;
+
+    thread_cache_set<Context>* m_owner;
+    std::atomic<pool_type*>    m_pool;
+    std::size_t                m_block_size;
+    std::size_t                m_capacity;
+    std::vector<block_type>    m_blocks;
+
+  public:
+    thread_cache(thread_cache_set<Context>* owner, pool_type* p, std::size_t block_size,
+        std::size_t capacity)
+    : m_owner{owner}
+    , m_pool{p}
+    , m_block_size{block_size}
+    , m_capacity{capacity}
+    {
+        m_blocks.reserve(m_capacity);
+    }
+
+    thread_cache(thread_cache const&) = delete;
+    thread_cache(thread_cache&&) = delete;
+
+    pool_type*  get_pool() const noexcept { return m_pool.load(std::memory_order_relaxed); }
+    std::size_t size() const noexcept { return m_blocks.size(); }
+    std::size_t bytes() const noexcept { return m_blocks.size() * m_block_size; }
+};
+
+// All caches of the calling thread, indexed by the pool's slot id. On thread exit the cached
+// blocks are handed back to their pools. The bytes of caches dropped by destroyed pools are
+// subtracted from the thread's total the next time a byte limit is checked.
+template<typename Context>
+class thread_cache_set
+{
+  public:
+    using cache_type = thread_cache<Context>;
+    using pool_type = typename cache_type::pool_type;
+    using block_type = typename cache_type::block_type;
+    using registry = thread_cache_registry<Context>;
+
+  private:
+    std::vector<std::unique_ptr<cache_type>> m_caches;
+    std::size_t                              m_bytes = 0u;
+    // bytes of caches dropped by destroyed pools, not yet subtracted from m_bytes
+    std::atomic<std::size_t> m_dropped_bytes{0u};
+
+  public:
+    thread_cache_set() = default;
+    thread_cache_set(thread_cache_set const&) = delete;
+    thread_cache_set(thread_cache_set&&) = delete;
+
+    ~thread_cache_set()
+    {
+        std::lock_guard<std::mutex> lock(registry::mutex());
+        for (auto& c : m_caches)
+        {
+            if (!c) continue;
+            if (auto p = c->get_pool()) p->detach_cache(c.get());
+        }
+    }
+
+    static thread_cache_set& instance()
+    {
+        static thread_local thread_cache_set s;
+        return s;
+    }
+
+    // return this thread's cache for pool p, create it on first use
+    cache_type& get(pool_type* p, std::size_t id)
+    {
+        if (id < m_caches.size() && m_caches[id] && m_caches[id]->get_pool() == p)
+            return *m_caches[id];
+        return attach(p, id);
+    }
+
+    // bytes held by all caches of the calling thread
+    std::size_t bytes() const noexcept
+    {
+        return m_bytes - m_dropped_bytes.load(std::memory_order_relaxed);
+    }
+
+    // number of blocks in the calling thread's cache for pool p
+    std::size_t size(pool_type* p, std::size_t id) { return get(p, id).size(); }
+
+    // the pool's block size must not exceed max_bytes
+    block_type allocate(pool_type* p, std::size_t id, std::size_t max_bytes)
+    {
+        auto& c = get(p, id);
+        if (c.m_blocks.empty())
+        {
+            reclaim_dropped_bytes();
+            // refill half of the capacity in one go, as far as the byte limit allows
+            const auto room = m_bytes < max_bytes ? (max_bytes - m_bytes) / c.m_block_size : 0u;
+            const auto n = std::max<std::size_t>(std::min(c.m_capacity / 2, room), 1u);
+            p->refill(c.m_blocks, n);
+            m_bytes += c.m_blocks.size() * c.m_block_size;
+        }
+        auto b = c.m_blocks.back();
+        c.m_blocks.pop_back();
+        m_bytes -= c.m_block_size;
+        return b;
+    }
+
+    // the pool's block size must not exceed max_bytes; returns false if the block does not fit
+    // into the cache
+    bool free(pool_type* p, std::size_t id, std::size_t max_bytes, block_type const& b)
+    {
+        auto& c = get(p, id);
+        if (m_bytes + c.m_block_size > max_bytes) reclaim_dropped_bytes();
+        if (c.m_blocks.size() >= c.m_capacity || m_bytes + c.m_block_size > max_bytes)
+        {
+            // flush the older half of the cache (or everything if the byte limit is hit)
+            const auto n = (c.m_blocks.size() >= c.m_capacity) ? (c.m_blocks.size() + 1) / 2
+                                                                : c.m_blocks.size();
+            p->flush(c.m_blocks.begin(), c.m_blocks.begin() + n);
+            c.m_blocks.erase(c.m_blocks.begin(), c.m_blocks.begin() + n);
+            m_bytes -= n * c.m_block_size;
+            if (m_bytes + c.m_block_size > max_bytes) return false;
+        }
+        c.m_blocks.push_back(b);
+        m_bytes += c.m_block_size;
+        return true;
+    }
+
+    // called by a pool on destruction with the thread_cache_registry mutex locked: the blocks of
+    // c point into segments which are about to be destroyed. The owning thread does not use c
+    // concurrently, but its byte count is only adjusted by the owning thread itself.
+    void drop(cache_type* c) noexcept
+    {
+        m_dropped_bytes.fetch_add(c->bytes(), std::memory_order_relaxed);
+        c->m_blocks.clear();
+        c->m_pool.store(nullptr, std::memory_order_relaxed);
+    }
+
+  private:
+    void reclaim_dropped_bytes() noexcept
+    {
+        if (m_dropped_bytes.load(std::memory_order_relaxed) > 0u)
+            m_bytes -= m_dropped_bytes.exchange(0u, std::memory_order_relaxed);
+    }
+
+    cache_type& attach(pool_type* p, std::size_t id)
+    {
+        std::lock_guard<std::mutex> lock(registry::mutex());
+        if (id >= m_caches.size()) m_caches.resize(id + 1);
+        // a cache left in the slot belongs to a destroyed pool and was dropped already
+        auto& c = m_caches[id];
+        c = std::make_unique<cache_type>(this, p, p->block_size(), p->thread_cache_size());
+        p->attach_cache(c.get());
+        return *c;
+    }
+};
+
+} // namespace detail
+} // namespace hwmalloc
@@ -10,8 +10,10 @@
 #pragma once
 
 #include <hwmalloc/detail/block.hpp>
+#include <hwmalloc/detail/registration_cache.hpp>
 #include <hwmalloc/fancy_ptr/void_ptr.hpp>
 #include <memory>
+#include <optional>
 #include <cstdlib>
 
 namespace hwmalloc
@@ -27,6 +29,8 @@ struct user_allocation
 #endif
     using block_type = block_t<Context>;
     using pointer = hw_void_ptr<block_type>;
+    using handle_type = typename block_type::handle_type;
+    using cache_type = registration_cache<Context>;
 
     struct host_allocation
     {
@@ -60,7 +64,11 @@ struct user_allocation
 
     //Context*                     m_context;
     host_allocation m_host_allocation;
-    region_type     m_region;
+    std::size_t     m_size;
+    // either an own registration or a shared one from the registration cache
+    std::optional<region_type>  m_region;
+    cache_type*                 m_cache = nullptr;
+    typename cache_type::entry* m_cache_entry = nullptr;
 #if HWMALLOC_ENABLE_DEVICE
     std::unique_ptr<device_region_type> m_device_region;
 #endif
@@ -68,13 +76,36 @@ struct user_allocation
     user_allocation(Context* context, void* ptr, std::size_t size)
     //: m_context{context}
     : m_host_allocation{ptr, false}
+    , m_size{size}
     , m_region{hwmalloc::register_memory(*context, ptr, size)}
     {
     }
 
+    user_allocation(cache_type* cache, void* ptr, std::size_t size)
+    : m_host_allocation{ptr, false}
+    , m_size{size}
+    , m_cache{cache}
+    , m_cache_entry{cache->acquire(ptr, size)}
+    {
+    }
+
+    user_allocation(user_allocation const&) = delete;
+
+    ~user_allocation()
+    {
+        if (m_cache_entry) m_cache->release(m_cache_entry);
+    }
+
+    handle_type get_handle() const noexcept
+    {
+        if (m_cache_entry) return m_cache_entry->get_handle(m_host_allocation.m_ptr, m_size);
+        return m_region->get_handle(0, m_size);
+    }
+
 #if HWMALLOC_ENABLE_DEVICE
     user_allocation(Context* context, void* device_ptr, int device_id, std::size_t size)
     : m_host_allocation{std::malloc(size), true}
+    , m_size{size}
     , m_region{hwmalloc::register_memory(*context, m_host_allocation.m_ptr, size)}
     , m_device_region{std::make_unique<device_region_type>(
           hwmalloc::register_device_memory(*context, device_id, device_ptr, size))}
@@ -83,6 +114,7 @@ struct user_allocation
 
     user_allocation(Context* context, void* ptr, void* device_ptr, int device_id, std::size_t size)
     : m_host_allocation{ptr, false}
+    , m_size{size}
     , m_region{hwmalloc::register_memory(*context, ptr, size)}
     , m_device_region{std::make_unique<device_region_type>(
           hwmalloc::register_device_memory(*context, device_id, device_ptr, size))}
@@ -91,6 +123,13 @@ struct user_allocation
 #endif
 };
 
+template<typename Context>
+typename block_t<Context>::handle_type
+block_t<Context>::handle_from_user_allocation() const noexcept
+{
+    return m_user_allocation->get_handle();
+}
+
 template<typename Context>
 void
 block_t<Context>::release_user_allocation() const noexcept
@@ -86,29 +86,20 @@ class hw_ptr<const T, Block>
   public: // iterator functions
     this_type& operator++() noexcept
     {
-        m_ptr.m_data.m_ptr = get() + 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + 1;
-#endif
+        m_ptr.m_data.advance(sizeof(T));
         return *this;
     }
 
     this_type operator++(int) noexcept
     {
         auto tmp = *this;
-        m_ptr.m_data.m_ptr = get() + 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + 1;
-#endif
+        m_ptr.m_data.advance(sizeof(T));
         return tmp;
     }
 
     this_type& operator+=(std::ptrdiff_t n) noexcept
     {
-        m_ptr.m_data.m_ptr = get() + n;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + n;
-#endif
+        m_ptr.m_data.advance(n * std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
@@ -116,29 +107,20 @@ class hw_ptr<const T, Block>
 
     this_type& operator--() noexcept
     {
-        m_ptr.m_data.m_ptr = get() - 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - 1;
-#endif
+        m_ptr.m_data.advance(-std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
     this_type operator--(int) noexcept
     {
         auto tmp = *this;
-        m_ptr.m_data.m_ptr = get() - 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - 1;
-#endif
+        m_ptr.m_data.advance(-std::ptrdiff_t(sizeof(T)));
         return tmp;
     }
 
     this_type& operator-=(std::ptrdiff_t n) noexcept
     {
-        m_ptr.m_data.m_ptr = get() - n;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - n;
-#endif
+        m_ptr.m_data.advance(-n * std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
@@ -55,7 +55,7 @@ class hw_void_ptr<Block, void const*>
     constexpr void const* get() const noexcept { return m_data.m_ptr; }
 
 #if HWMALLOC_ENABLE_DEVICE
-    constexpr void const* device_ptr() const noexcept { return m_data.m_device_ptr; }
+    void const* device_ptr() const noexcept { return m_data.device_ptr(); }
 #endif
 
     constexpr operator bool() const noexcept { return (bool)m_data.m_ptr; }
@@ -100,29 +100,20 @@ class hw_ptr
   public: // iterator functions
     this_type& operator++() noexcept
     {
-        m_ptr.m_data.m_ptr = get() + 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + 1;
-#endif
+        m_ptr.m_data.advance(sizeof(T));
         return *this;
     }
 
     this_type operator++(int) noexcept
     {
         auto tmp = *this;
-        m_ptr.m_data.m_ptr = get() + 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + 1;
-#endif
+        m_ptr.m_data.advance(sizeof(T));
         return tmp;
     }
 
     this_type& operator+=(std::ptrdiff_t n) noexcept
     {
-        m_ptr.m_data.m_ptr = get() + n;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() + n;
-#endif
+        m_ptr.m_data.advance(n * std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
@@ -131,29 +122,20 @@ class hw_ptr
 
     this_type& operator--() noexcept
     {
-        m_ptr.m_data.m_ptr = get() - 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - 1;
-#endif
+        m_ptr.m_data.advance(-std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
     this_type operator--(int) noexcept
     {
         auto tmp = *this;
-        m_ptr.m_data.m_ptr = get() - 1;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - 1;
-#endif
+        m_ptr.m_data.advance(-std::ptrdiff_t(sizeof(T)));
         return tmp;
     }
 
     this_type& operator-=(std::ptrdiff_t n) noexcept
     {
-        m_ptr.m_data.m_ptr = get() - n;
-#if HWMALLOC_ENABLE_DEVICE
-        if (m_ptr.device_ptr()) m_ptr.m_data.m_device_ptr = device_ptr() - n;
-#endif
+        m_ptr.m_data.advance(-n * std::ptrdiff_t(sizeof(T)));
         return *this;
     }
 
@@ -15,7 +15,7 @@
 
 namespace hwmalloc
 {
-template<typename Context>
+template<typename Context, typename Block>
 class heap;
 template<typename T, typename Block>
 class hw_ptr;
@@ -25,7 +25,7 @@ class hw_void_ptr
 {
   private:
     using this_type = hw_void_ptr<Block, VoidPtr>;
-    template<typename Context>
+    template<typename Context, typename B>
     friend class heap;
     friend class hw_void_ptr<Block, void const*>;
     template<typename T, typename B>
@@ -70,14 +70,14 @@ class hw_void_ptr
 
     constexpr VoidPtr get() const noexcept { return m_data.m_ptr; }
 
-    auto handle() const noexcept { return m_data.m_handle; }
+    auto handle() const noexcept { return m_data.handle(); }
 
 #if HWMALLOC_ENABLE_DEVICE
-    constexpr VoidPtr device_ptr() const noexcept { return m_data.m_device_ptr; }
+    VoidPtr device_ptr() const noexcept { return m_data.device_ptr(); }
 
-    auto device_handle() const noexcept { return m_data.m_device_handle; }
+    auto device_handle() const noexcept { return m_data.device_handle(); }
 
-    int device_id() const noexcept { return m_data.m_device_id; }
+    int device_id() const noexcept { return m_data.device_id(); }
 #endif
 
     bool on_device() const noexcept { return m_data.on_device(); }
@@ -11,16 +11,49 @@
 
 #include <hwmalloc/detail/user_allocation.hpp>
 #include <hwmalloc/detail/fixed_size_heap.hpp>
+#include <hwmalloc/detail/extent_heap.hpp>
+#include <hwmalloc/detail/compact_block.hpp>
+#include <hwmalloc/detail/size_classes.hpp>
 #include <hwmalloc/fancy_ptr/void_ptr.hpp>
 #include <hwmalloc/fancy_ptr/const_void_ptr.hpp>
 #include <hwmalloc/fancy_ptr/unique_ptr.hpp>
 #include <hwmalloc/heap_config.hpp>
 #include <hwmalloc/allocator.hpp>
+#include <boost/iterator/function_output_iterator.hpp>
+#include <algorithm>
+#include <array>
 #include <vector>
-#include <unordered_map>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 
 namespace hwmalloc
 {
+// Memory held by a heap, broken down by size class (see heap::stats).
+struct heap_stats
+{
+    detail::pool_stats m_tiny;
+    detail::pool_stats m_small;
+    detail::pool_stats m_large;
+    detail::pool_stats m_huge;
+    // arenas of heap_config::m_segment_arenas: not part of the total, their memory is accounted
+    // to the segments carved from them
+    detail::pool_stats m_segment_arenas;
+
+    detail::pool_stats total() const noexcept
+    {
+        detail::pool_stats res;
+        res += m_tiny;
+        res += m_small;
+        res += m_large;
+        res += m_huge;
+        return res;
+    }
+};
+
 // Main class of this library. Provides a heap for allocating memory on given numa nodes and
 // devices. The memory is requested from the OS/runtime in large segments which are kept alive.
 // After allocation of these segments, the memory is given to the Context for registering with e.g.
@@ -35,19 +68,24 @@ namespace hwmalloc
 // (effectively mirroring the memory). Both memory regions are passed to the Context for
 // registration. Note, that setting a numa node for device memory allocation is therefore still
 // necessary.
-template<typename Context>
+//
+// The Block parameter selects the representation of the fancy pointers: the default block_t
+// stores all metadata by value, detail::compact_block_t only the address (see compact_heap).
+template<typename Context, typename Block = detail::block_t<Context>>
 class heap
 {
   public:
-    using this_type = heap<Context>;
+    using this_type = heap<Context, Block>;
     using region_type = typename detail::region_traits<Context>::region_type;
 #if HWMALLOC_ENABLE_DEVICE
     using device_region_type = typename detail::region_traits<Context>::device_region_type;
 #endif
     using fixed_size_heap_type = detail::fixed_size_heap<Context>;
-    using block_type = typename fixed_size_heap_type::block_type;
+    using block_type = Block;
+    // block with all metadata, as stored in the free lists
+    using internal_block_type = typename fixed_size_heap_type::block_type;
     using heap_vector = std::vector<std::unique_ptr<fixed_size_heap_type>>;
-    using heap_map = std::unordered_map<std::size_t, std::unique_ptr<fixed_size_heap_type>>;
+    using heap_slots = std::unique_ptr<std::atomic<fixed_size_heap_type*>[]>;
     using pointer = hw_void_ptr<block_type>;
     using const_pointer = hw_const_void_ptr<block_type>;
     template<typename T>
@@ -56,6 +94,20 @@ class heap
     using typed_pointer = typename allocator_type<T>::pointer;
     template<typename T>
     using unique_ptr = unique_ptr<T, block_type>;
+    using handle_type = typename pointer::handle_type;
+
+    // number of pointers free_bulk sorts without allocating
+    static constexpr std::size_t free_bulk_buffer_size = 64;
+
+    // result of heap::lookup, converts to false if the address is unknown
+    struct lookup_result
+    {
+        pointer     m_block;         // start of the block which contains the address
+        handle_type m_handle{};      // handle of that block
+        std::size_t m_numa_node = 0; // numa node of the host memory
+
+        explicit operator bool() const noexcept { return (bool)m_block; }
+    };
 
     // Note: sizes below are defaults and can be changed through heap_config and
     // environment variables.
@@ -68,22 +120,24 @@ class heap
     // - huge:  heaps with exponentially increasing block sizes, each heap backed by segments of
     //          size = block size
     // - Huge:  heaps with exponentially increasing block sizes, each heap backed by segments of
-    //          size = block size. These heaps can use arbitrary large block sizes and are stored
-    //          in a map (created on demand). Access is synchronized among threads using a mutex.
-    //          TODO: can this be made more efficient?
+    //          size = block size. These heaps can use arbitrary large block sizes and are created
+    //          on demand. They are stored in an array of atomic pointers indexed by size class:
+    //          lookups are lock-free, creation installs the heap with a compare-and-swap.
+    //          With heap_config::m_huge_extents, host allocations in this range are instead carved
+    //          from large arenas in page granular extents (see detail::extent_heap).
     //
     //     block  segment / pages / h / hex      blocks/segment
     //   ------------------------------------------------------ tiny
     //         8   16384 /  4 / 16KiB / 0x04000            2048  |        -+
     //        16   16384 /  4 / 16KiB / 0x04000            1024  v         |
     //        24   16384 /  4 / 16KiB / 0x04000             682            |
-    //        32   16384 /  4 / 16KiB / 0x04000             512            |  m_tiny_heaps: vector
+    //        32   16384 /  4 / 16KiB / 0x04000             512            |
     //        40   16384 /  4 / 16KiB / 0x04000             409            |
     //        48   16384 /  4 / 16KiB / 0x04000             341            |
     //         :                                                           :
-    //       128   16384 /  4 / 16KiB / 0x04000             128           -+
-    //   ------------------------------------------------------ small
-    //       256   32768 /  8 / 32KiB / 0x08000             128  |        -+
+    //       128   16384 /  4 / 16KiB / 0x04000             128            |
+    //   ------------------------------------------------------ small      |
+    //       256   32768 /  8 / 32KiB / 0x08000             128  |         |
     //       512   32768 /  8 / 32KiB / 0x08000              64  v         |
     //      1024   32768 /  8 / 32KiB / 0x08000              32            |
     //   ------------------------------------------------------ large      |
@@ -98,65 +152,331 @@ class heap
     //    :                                                      v         |
     //    max_size                                            1           -+
     //  -------------------------------------------------------- Huge
-    //    stored in map                                                   -+
-    //    :                                                                :  m_huge_heaps: map
+    //    created on demand                                               -+
+    //    :                                                                :  m_huge_heaps: array
+    //
+    // Segments are page aligned and blocks are laid out contiguously, therefore a block is aligned
+    // to the largest power of two which divides its block size (at most the page size). Aligned
+    // allocations round the size up to a multiple of the alignment: the class of such a size is
+    // itself a multiple of the alignment, so no memory is skipped and the handle matches the
+    // returned address.
+    //
+    // With heap_config::m_size_class_steps > 1, the small, large and huge ranges are refined: each
+    // doubling is split into several classes of equal width (see detail::size_classes), e.g. with
+    // 4 steps: 160, 192, 224, 256, 320, 384, 448, 512, ...
+    //
+    // The index into m_heaps is resolved by detail::size_class_map: a lookup table (one entry per
+    // tiny increment) up to the small limit, the position of the leading bit above.
 
   private:
-    static std::size_t tiny_bucket_index(std::size_t n, std::size_t tiny_increment,
-        std::size_t tiny_increment_shift) noexcept
+    // shrink the segment to the blocks it can hold: block sizes which are not powers of two would
+    // otherwise leave the tail of the segment unused
+    static std::size_t fit_segment_size(std::size_t block_size, std::size_t segment_size) noexcept
+    {
+        return std::max<std::size_t>(segment_size / block_size, 1u) * block_size;
+    }
+
+    // per size class pool settings, provisioner is null if there is no worker thread: segments
+    // are built in advance only if provision is set
+    static detail::pool_config make_pool_config(heap const* owner, heap_config const& config,
+        detail::provisioner* provisioner, bool provision, detail::memory_budget* budget,
+        bool madvise, bool prefault) noexcept
+    {
+        detail::pool_config res;
+        res.m_owner = owner;
+        res.m_thread_cache_size = config.m_thread_cache_size;
+        res.m_thread_cache_max_bytes = config.m_thread_cache_max_bytes;
+        res.m_lazy_carving = config.m_lazy_carving;
+        res.m_provisioner = provisioner;
+        if (provisioner && provision)
+        {
+            res.m_provision_low_watermark = config.m_provision_low_watermark;
+            res.m_provision_high_watermark =
+                std::max(config.m_provision_high_watermark, config.m_provision_low_watermark);
+        }
+        res.m_segment_decay_ms = config.m_segment_decay_ms;
+        res.m_madvise = madvise;
+        res.m_prefault = prefault;
+        res.m_budget = budget;
+        res.m_huge_page_size = config.m_huge_page_size;
+        res.m_hugetlb = config.m_hugetlb;
+        res.m_page_map = page_mapped(config);
+        return res;
+    }
+
+    // compact pointers resolve their metadata through the page map
+    static bool page_mapped(heap_config const& config) noexcept
+    {
+        return config.m_page_map || !std::is_same<Block, detail::block_t<Context>>::value;
+    }
+
+    // translate budget_exceeded into a null pointer unless configured otherwise
+    template<typename F>
+    pointer checked_allocate(F&& f)
+    {
+        try
+        {
+            return to_pointer(f());
+        }
+        catch (budget_exceeded const&)
+        {
+            if (m_config.m_memory_limit_throws) throw;
+            return {};
+        }
+    }
+
+    // bulk version: the pointers which could not be allocated are set to null
+    template<typename OutputIterator, typename F>
+    OutputIterator checked_allocate_bulk(std::size_t count, OutputIterator& out, F&& f)
     {
-        return ((n + tiny_increment - 1) >> tiny_increment_shift) - 1;
+        std::size_t n = 0u;
+        try
+        {
+            f(boost::make_function_output_iterator(
+                [&out, &n](internal_block_type const& b)
+                {
+                    *out++ = to_pointer(b);
+                    ++n;
+                }));
+        }
+        catch (budget_exceeded const&)
+        {
+            if (m_config.m_memory_limit_throws) throw;
+            for (; n < count; ++n) *out++ = pointer{};
+        }
+        return out;
     }
 
-    static std::size_t bucket_index(std::size_t n, std::size_t bucket_shift) noexcept
+    static pointer to_pointer(internal_block_type const& b) noexcept { return {block_type{b}}; }
+
+    // objects are never constructed in a null pointer, whatever m_memory_limit_throws says
+    static pointer non_null(pointer p)
     {
-        return detail::log2_c((n - 1) >> bucket_shift) - 1;
+        if (!p) throw std::bad_alloc();
+        return p;
     }
 
+#if HWMALLOC_ENABLE_DEVICE
+    static pointer make_user_pointer(detail::user_allocation<Context>* a, void* ptr,
+        void* device_ptr, int device_id, std::size_t size)
+    {
+        internal_block_type b{{}, nullptr, a, ptr};
+        b.update_handle();
+        b.m_device_ptr = device_ptr;
+        b.m_device_handle = a->m_device_region->get_handle(0, size);
+        b.m_device_id = device_id;
+        return to_pointer(b);
+    }
+#endif
+
+    // resolve the fixed_size_heap responsible for allocations of the given size: a table lookup
+    // for small sizes, the position of the leading bit up to m_max_size
+    fixed_size_heap_type* get_heap(std::size_t size)
+    {
+        if (size <= m_max_size) return m_heaps[m_size_classes.index(size)].get();
+        auto& slot = m_huge_heaps[m_size_classes.index(size) - m_heaps.size()];
+        if (auto h = slot.load(std::memory_order_acquire)) return h;
+        return make_huge_heap(slot, m_size_classes.round_up(size));
+    }
+
+    // install a new heap in an empty slot: if another thread is faster, its heap is used and ours
+    // is discarded (it has not allocated any memory yet)
+    fixed_size_heap_type* make_huge_heap(std::atomic<fixed_size_heap_type*>& slot,
+        std::size_t block_size)
+    {
+        auto h = std::make_unique<fixed_size_heap_type>(m_context, block_size, block_size,
+            m_config.m_never_free, m_config.m_num_reserve_segments, m_huge_pool_config,
+            m_segment_arenas.get());
+        fixed_size_heap_type* expected = nullptr;
+        if (slot.compare_exchange_strong(expected, h.get(), std::memory_order_acq_rel,
+                std::memory_order_acquire))
+            return h.release();
+        return expected;
+    }
+
+    template<typename F>
+    void for_each_huge_heap(F&& f)
+    {
+        for (std::size_t i = 0; i < m_num_huge_slots; ++i)
+            if (auto h = m_huge_heaps[i].load(std::memory_order_acquire)) f(*h);
+    }
+
+    // size which is served by a class satisfying the alignment, see above
+    static std::size_t aligned_size(std::size_t size, std::align_val_t alignment)
+    {
+        const auto a = static_cast<std::size_t>(alignment);
+        if (a == 0u || (a & (a - 1u)) != 0u || a > numa().page_size())
+            throw std::runtime_error("hwmalloc: alignment " + std::to_string(a) +
+                                     " is not a power of two or exceeds the page size");
+        return ((std::max<std::size_t>(size, 1u) + a - 1u) / a) * a;
+    }
+
+    // host allocations above m_max_size are served by the extent heap if enabled
+    internal_block_type allocate_block(std::size_t size, std::size_t numa_node)
+    {
+        if (size > m_max_size && m_extents) return m_extents->allocate(numa_node, size);
+        return get_heap(size)->allocate(numa_node);
+    }
+
+    // the block lies on pages which were zero-filled by the system and not handed out before
+    static bool is_fresh(internal_block_type const& b) noexcept
+    {
+        if (b.m_segment) return b.m_segment->fresh();
+        return b.m_extent && b.m_extent->m_fresh;
+    }
+
+    static std::size_t next_static_size_slot() noexcept
+    {
+        static std::atomic<std::size_t> next_slot{0u};
+        return next_slot.fetch_add(1u, std::memory_order_relaxed);
+    }
+
+    // slot of a compile time size in m_static_heaps, assigned on first use (shared by all heaps)
+    template<std::size_t Size>
+    static std::size_t static_size_slot() noexcept
+    {
+        static const std::size_t slot = next_static_size_slot();
+        return slot;
+    }
+
+    // compile time size: the index of the tiny classes does not depend on the configuration and
+    // is folded into a constant, the heap of a larger size is cached in m_static_heaps once it was
+    // resolved. Returns null if it was not resolved yet.
+    template<std::size_t Size>
+    fixed_size_heap_type* cached_heap() noexcept
+    {
+        constexpr auto tiny_index = detail::size_class_map::tiny_index(Size);
+        if (Size <= m_config.m_tiny_limit) return m_heaps[tiny_index].get();
+        const auto slot = static_size_slot<Size>();
+        if (slot >= num_static_size_slots) return nullptr;
+        return m_static_heaps[slot].load(std::memory_order_acquire);
+    }
+
+    // resolve the heap of a compile time size through the runtime dispatch on the first call:
+    // sizes served by the extent heap are not cached, see allocate<Size>
+    template<std::size_t Size>
+    fixed_size_heap_type* get_heap()
+    {
+        if (auto h = cached_heap<Size>()) return h;
+        auto       h = get_heap(Size);
+        const auto slot = static_size_slot<Size>();
+        if (slot < num_static_size_slots && (Size <= m_max_size || !m_extents))
+            m_static_heaps[slot].store(h, std::memory_order_release);
+        return h;
+    }
+
+    // number of compile time sizes above the tiny limit whose heap is cached, further sizes go
+    // through the runtime dispatch
+    static constexpr std::size_t num_static_size_slots = 64u;
+
   private:
     heap_config m_config;
-    Context*    m_context;
-    std::size_t m_max_size;
-    heap_vector m_tiny_heaps;
-    heap_vector m_heaps;
-    heap_map    m_huge_heaps;
-    std::mutex  m_mutex;
+    // declared before the heaps: pools withdraw their requests when they are destroyed
+    std::unique_ptr<detail::provisioner> m_provisioner;
+    // declared before the heaps: pools return their memory when they are destroyed
+    std::unique_ptr<detail::memory_budget> m_budget;
+    detail::pool_config                  m_tiny_pool_config;
+    detail::pool_config                  m_small_pool_config;
+    detail::pool_config                  m_large_pool_config;
+    // huge segments hold a single block and are not provisioned in advance
+    detail::pool_config m_huge_pool_config;
+    Context*               m_context;
+    detail::size_class_map m_size_classes;
+    std::size_t            m_max_size;
+    // declared before the heaps: segments return their extents when they are destroyed. The
+    // extents are not entered in the page map, the segments carved from them are.
+    std::unique_ptr<detail::extent_heap<Context>> m_segment_arenas;
+    heap_vector            m_heaps; // tiny classes first, indexed by m_size_classes
+    std::size_t            m_num_huge_slots;
+    heap_slots             m_huge_heaps; // classes above m_max_size, created on demand
+    heap_slots             m_static_heaps; // resolved heaps of compile time sizes, see get_heap
+    std::unique_ptr<detail::extent_heap<Context>> m_extents;
+    std::unique_ptr<detail::registration_cache<Context>> m_registration_cache;
 
   public:
     heap(Context* context, heap_config const& config = get_default_heap_config())
     : m_config{config}
+    , m_provisioner{(m_config.m_provision_low_watermark > 0u || m_config.m_segment_decay_ms > 0u)
+                        ? std::make_unique<detail::provisioner>()
+                        : nullptr}
+    , m_budget{(m_config.m_memory_limit > 0u || m_config.m_memory_soft_limit > 0u ||
+                   m_config.m_numa_memory_limit > 0u)
+                   ? std::make_unique<detail::memory_budget>(m_config.m_memory_limit,
+                         m_config.m_memory_soft_limit, m_config.m_numa_memory_limit)
+                   : nullptr}
+    , m_tiny_pool_config{make_pool_config(this, m_config, m_provisioner.get(), true,
+          m_budget.get(), m_config.m_tiny_madvise, m_config.m_tiny_prefault)}
+    , m_small_pool_config{make_pool_config(this, m_config, m_provisioner.get(), true,
+          m_budget.get(), m_config.m_small_madvise, m_config.m_small_prefault)}
+    , m_large_pool_config{make_pool_config(this, m_config, m_provisioner.get(), true,
+          m_budget.get(), m_config.m_large_madvise, m_config.m_large_prefault)}
+    , m_huge_pool_config{make_pool_config(this, m_config, m_provisioner.get(), false,
+          m_budget.get(), m_config.m_huge_madvise, m_config.m_huge_prefault)}
     , m_context{context}
+    , m_size_classes{m_config.m_tiny_limit, m_config.m_size_class_steps, m_config.m_small_limit}
     , m_max_size(
           std::max(detail::round_to_pow_of_2(m_config.m_large_limit * 2), m_config.m_large_limit))
-    , m_tiny_heaps(m_config.m_tiny_limit / m_config.m_tiny_increment)
-    , m_heaps(bucket_index(m_max_size, m_config.m_bucket_shift) + 1)
+    , m_segment_arenas{m_config.m_segment_arenas
+                           ? std::make_unique<detail::extent_heap<Context>>(m_context,
+                                 m_config.m_segment_arena_size, m_config.m_never_free, nullptr,
+                                 m_config.m_huge_page_size, m_config.m_hugetlb, false)
+                           : nullptr}
+    , m_heaps(m_size_classes.num_classes(m_max_size))
+    , m_num_huge_slots{m_size_classes.num_classes(~std::size_t(0)) - m_heaps.size()}
+    , m_huge_heaps{new std::atomic<fixed_size_heap_type*>[m_num_huge_slots]}
+    , m_static_heaps{new std::atomic<fixed_size_heap_type*>[num_static_size_slots]}
+    , m_extents{m_config.m_huge_extents
+                    ? std::make_unique<detail::extent_heap<Context>>(m_context,
+                          m_config.m_extent_arena_size, m_config.m_never_free, m_budget.get(),
+                          m_config.m_huge_page_size, m_config.m_hugetlb, page_mapped(m_config))
+                    : nullptr}
+    , m_registration_cache{m_config.m_registration_cache
+                               ? std::make_unique<detail::registration_cache<Context>>(m_context,
+                                     m_config.m_registration_cache_limit)
+                               : nullptr}
     {
-        for (std::size_t i = 0; i < m_tiny_heaps.size(); ++i)
-            m_tiny_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context,
-                m_config.m_tiny_increment * (i + 1), m_config.m_tiny_segment_size,
-                m_config.m_never_free, m_config.m_num_reserve_segments);
-
-        for (std::size_t i = 0; i < m_config.m_num_small_heaps; ++i)
-            m_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context,
-                (m_config.m_tiny_limit << (i + 1)), m_config.m_small_segment_size,
-                m_config.m_never_free, m_config.m_num_reserve_segments);
+        for (std::size_t i = 0; i < m_num_huge_slots; ++i) m_huge_heaps[i].store(nullptr);
+        for (std::size_t i = 0; i < num_static_size_slots; ++i) m_static_heaps[i].store(nullptr);
 
-        for (std::size_t i = 0; i < m_config.m_num_large_heaps; ++i)
-            m_heaps[i + m_config.m_num_small_heaps] = std::make_unique<fixed_size_heap_type>(
-                m_context, (m_config.m_small_limit << (i + 1)), m_config.m_large_segment_size,
-                m_config.m_never_free, m_config.m_num_reserve_segments);
+        for (std::size_t i = 0; i < m_heaps.size(); ++i)
+        {
+            const auto block_size = m_size_classes.block_size(i);
+            if (i < m_size_classes.num_tiny())
+                m_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context, block_size,
+                    m_config.m_tiny_segment_size, m_config.m_never_free,
+                    m_config.m_num_reserve_segments, m_tiny_pool_config, m_segment_arenas.get());
+            else if (block_size <= m_config.m_small_limit)
+                m_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context, block_size,
+                    fit_segment_size(block_size, m_config.m_small_segment_size),
+                    m_config.m_never_free, m_config.m_num_reserve_segments, m_small_pool_config,
+                    m_segment_arenas.get());
+            else if (block_size <= m_config.m_large_limit)
+                m_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context, block_size,
+                    fit_segment_size(block_size, m_config.m_large_segment_size),
+                    m_config.m_never_free, m_config.m_num_reserve_segments, m_large_pool_config,
+                    m_segment_arenas.get());
+            else
+                m_heaps[i] = std::make_unique<fixed_size_heap_type>(m_context, block_size,
+                    block_size, m_config.m_never_free, m_config.m_num_reserve_segments,
+                    m_huge_pool_config, m_segment_arenas.get());
+        }
 
-        for (std::size_t i = 0;
-             i < m_heaps.size() - (m_config.m_num_small_heaps + m_config.m_num_large_heaps); ++i)
-            m_heaps[i + m_config.m_num_small_heaps + m_config.m_num_large_heaps] =
-                std::make_unique<fixed_size_heap_type>(m_context,
-                    (m_config.m_large_limit << (i + 1)), (m_config.m_large_limit << (i + 1)),
-                    m_config.m_never_free, m_config.m_num_reserve_segments);
+        // exceeding the soft limit releases unused memory of all pools
+        if (m_budget) m_budget->set_purge_callback([this]() { purge(); });
     }
 
     heap(heap const&) = delete;
     heap(heap&&) = delete;
 
+    ~heap()
+    {
+        // nothing may purge or provision while the heaps are torn down
+        if (m_budget) m_budget->set_purge_callback({});
+        if (m_provisioner) m_provisioner->stop();
+        for (std::size_t i = 0; i < m_num_huge_slots; ++i)
+            delete m_huge_heaps[i].exchange(nullptr, std::memory_order_acq_rel);
+    }
+
     Context& context() noexcept { return *m_context; }
 
     // --------------------------------------------------
@@ -174,74 +494,125 @@ class heap
         return instance;
     }
 
+    // returns a null pointer if the memory limit is hit and m_memory_limit_throws is not set
     pointer allocate(std::size_t size, std::size_t numa_node)
     {
-        if (size <= m_config.m_tiny_limit)
-            return {m_tiny_heaps[tiny_bucket_index(size, m_config.m_tiny_increment,
-                                     m_config.m_tiny_increment_shift)]
-                        ->allocate(numa_node)};
-        else if (size <= m_max_size)
-            return {m_heaps[bucket_index(size, m_config.m_bucket_shift)]->allocate(numa_node)};
-        else
-        {
-            fixed_size_heap_type* h;
+        return checked_allocate([&]() { return allocate_block(size, numa_node); });
+    }
+
+    // alignment must be a power of two not larger than the page size
+    pointer allocate(std::size_t size, std::align_val_t alignment, std::size_t numa_node)
+    {
+        return allocate(aligned_size(size, alignment), numa_node);
+    }
+
+    // like allocate, with the memory filled with zeros: the memset is skipped for blocks on fresh
+    // pages (segments and arenas which came zero-filled from the system and did not get any memory
+    // back yet), plain allocate does not zero the memory
+    pointer allocate_zeroed(std::size_t size, std::size_t numa_node)
+    {
+        return checked_allocate(
+            [&]()
             {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                const auto                  s = detail::round_to_pow_of_2(size);
-                auto&                       u_ptr = m_huge_heaps[s];
-                if (!u_ptr)
-                    u_ptr = std::make_unique<fixed_size_heap_type>(m_context, s, s,
-                        m_config.m_never_free, m_config.m_num_reserve_segments);
-                h = u_ptr.get();
-            }
-            return {h->allocate(numa_node)};
-        }
+                auto b = allocate_block(size, numa_node);
+                if (!is_fresh(b)) std::memset(b.m_ptr, 0, size);
+                return b;
+            });
+    }
+
+    // allocation of a size known at compile time, e.g. allocate<sizeof(header)>(numa_node): after
+    // the first call the fixed_size_heap is taken from a per heap cache without size dispatch
+    template<std::size_t Size>
+    pointer allocate(std::size_t numa_node)
+    {
+        return checked_allocate(
+            [&]()
+            {
+                if (auto h = cached_heap<Size>()) return h->allocate(numa_node);
+                if (Size > m_max_size && m_extents) return m_extents->allocate(numa_node, Size);
+                return get_heap<Size>()->allocate(numa_node);
+            });
+    }
+
+    // allocate count blocks of the same size and write the pointers to out
+    template<typename OutputIterator>
+    OutputIterator allocate_bulk(std::size_t size, std::size_t numa_node, std::size_t count,
+        OutputIterator out)
+    {
+        return checked_allocate_bulk(count, out,
+            [&](auto it)
+            {
+                if (size > m_max_size && m_extents)
+                    for (std::size_t i = 0; i < count; ++i)
+                        *it++ = m_extents->allocate(numa_node, size);
+                else
+                    get_heap(size)->allocate_bulk(numa_node, count, it);
+            });
     }
 
+    static constexpr bool supports_user_allocations =
+        std::is_same<block_type, internal_block_type>::value;
+
+    // With heap_config::m_registration_cache, the registration is shared with earlier ones which
+    // cover the range. Such memory must be passed to invalidate_user_allocations before it is
+    // returned to the system, and the pointers must be freed before the heap is destroyed.
     pointer register_user_allocation(void* ptr, std::size_t size)
     {
-        auto a = new detail::user_allocation<Context>{m_context, ptr, size};
-        return {block_type{nullptr, a, ptr, a->m_region.get_handle(0, size)}};
+        static_assert(supports_user_allocations, "compact pointers can not hold user allocations");
+        auto a = m_registration_cache
+                     ? new detail::user_allocation<Context>{m_registration_cache.get(), ptr, size}
+                     : new detail::user_allocation<Context>{m_context, ptr, size};
+        internal_block_type b{{}, nullptr, a, ptr};
+        b.update_handle();
+        return to_pointer(b);
+    }
+
+    // invalidation hook of the registration cache: drops the cached registrations which overlap
+    // the range, those still in use are deregistered when their last pointer is freed
+    void invalidate_user_allocations(void* ptr, std::size_t size) noexcept
+    {
+        if (m_registration_cache) m_registration_cache->invalidate(ptr, size);
     }
 
 #if HWMALLOC_ENABLE_DEVICE
+    pointer allocate(std::size_t size, std::align_val_t alignment, std::size_t numa_node,
+        int device_id)
+    {
+        return allocate(aligned_size(size, alignment), numa_node, device_id);
+    }
+
     pointer allocate(std::size_t size, std::size_t numa_node, int device_id)
     {
-        if (size <= m_config.m_tiny_limit)
-            return {m_tiny_heaps[tiny_bucket_index(size, m_config.m_tiny_increment,
-                                     m_config.m_tiny_increment_shift)]
-                        ->allocate(numa_node, device_id)};
-        else if (size <= m_max_size)
-            return {m_heaps[bucket_index(size, m_config.m_bucket_shift)]->allocate(numa_node,
-                device_id)};
-        else
-        {
-            fixed_size_heap_type* h;
-            {
-                std::lock_guard<std::mutex> lock(m_mutex);
-                const auto                  s = detail::round_to_pow_of_2(size);
-                auto&                       u_ptr = m_huge_heaps[s];
-                if (!u_ptr)
-                    u_ptr = std::make_unique<fixed_size_heap_type>(m_context, s, s,
-                        m_config.m_never_free, m_config.m_num_reserve_segments);
-                h = u_ptr.get();
-            }
-            return {h->allocate(numa_node, device_id)};
-        }
+        return checked_allocate([&]() { return get_heap(size)->allocate(numa_node, device_id); });
+    }
+
+    template<std::size_t Size>
+    pointer allocate(std::size_t numa_node, int device_id)
+    {
+        return checked_allocate(
+            [&]() { return get_heap<Size>()->allocate(numa_node, device_id); });
+    }
+
+    template<typename OutputIterator>
+    OutputIterator allocate_bulk(std::size_t size, std::size_t numa_node, int device_id,
+        std::size_t count, OutputIterator out)
+    {
+        return checked_allocate_bulk(count, out,
+            [&](auto it) { get_heap(size)->allocate_bulk(numa_node, device_id, count, it); });
     }
 
     pointer register_user_allocation(void* device_ptr, int device_id, std::size_t size)
     {
+        static_assert(supports_user_allocations, "compact pointers can not hold user allocations");
         auto a = new detail::user_allocation<Context>{m_context, device_ptr, device_id, size};
-        return {block_type{nullptr, a, a->m_host_allocation.m_ptr, a->m_region.get_handle(0, size),
-            device_ptr, a->m_device_region->get_handle(0, size), device_id}};
+        return make_user_pointer(a, a->m_host_allocation.m_ptr, device_ptr, device_id, size);
     }
 
     pointer register_user_allocation(void* ptr, void* device_ptr, int device_id, std::size_t size)
     {
+        static_assert(supports_user_allocations, "compact pointers can not hold user allocations");
         auto a = new detail::user_allocation<Context>{m_context, ptr, device_ptr, device_id, size};
-        return {block_type{nullptr, a, ptr, a->m_region.get_handle(0, size), device_ptr,
-            a->m_device_region->get_handle(0, size), device_id}};
+        return make_user_pointer(a, ptr, device_ptr, device_id, size);
     }
 #endif
 
@@ -251,6 +622,153 @@ class heap
         ptr.m_data.release();
     }
 
+    // Find the block which contains a raw host address, e.g. one obtained from third party code.
+    // The lookup goes through the page map (see detail::page_map): it is lock-free and takes
+    // constant time. Blocks of this heap are found if it uses the page map (heap_config::m_page_map
+    // or compact heaps). The page map is shared by all heaps of the Context: blocks of other heaps
+    // and user allocations yield a null result.
+    lookup_result lookup(void const* ptr) const noexcept
+    {
+        lookup_result res;
+        if (!ptr) return res;
+        const auto e = detail::page_map<Context>::instance().find(ptr);
+        if (e.m_segment)
+        {
+            if (e.m_segment->get_pool()->owner() != this) return res;
+            const auto b = e.m_segment->block_at(ptr);
+            if (b.m_ptr) res = {to_pointer(b), b.handle(), e.m_segment->numa_node()};
+        }
+        else if (e.m_extent && m_extents && m_extents->owns(e.m_extent->m_pool))
+        {
+            internal_block_type b;
+            b.m_ptr = e.m_extent->m_ptr;
+            b.m_extent = e.m_extent;
+            b.update_handle();
+            res = {to_pointer(b), b.handle(), e.m_extent->m_pool->numa_node()};
+        }
+        return res;
+    }
+
+    // free the block which contains ptr, throws if ptr was not allocated by this heap
+    void free(void* ptr)
+    {
+        if (!ptr) return;
+        auto res = lookup(ptr);
+        if (!res)
+            throw std::runtime_error("hwmalloc: address was not allocated by this heap");
+        free(res.m_block);
+    }
+
+    // Resize an allocation. It stays in place if the block's size class has room, or for extents if
+    // the free space behind the extent can be appended (no new registration is needed in either
+    // case). Otherwise the contents are copied to a new block on the same numa node and the old
+    // block is freed. The returned pointer replaces ptr: its handle covers the new size. A null
+    // pointer is returned (and ptr remains valid) if the memory limit is hit and
+    // m_memory_limit_throws is not set. User and device allocations can not be reallocated.
+    template<typename VoidPtr>
+    pointer reallocate(hw_void_ptr<block_type, VoidPtr> const& ptr, std::size_t new_size)
+    {
+        internal_block_type b = ptr.m_data.resolve();
+        if (!b.m_ptr) return allocate(new_size, numa().local_node());
+        if (b.m_user_allocation || b.on_device())
+            throw std::runtime_error(
+                "hwmalloc: user and device allocations can not be reallocated");
+
+        std::size_t capacity, numa_node;
+        if (b.m_extent)
+        {
+            auto p = b.m_extent->m_pool;
+            if (p->grow(b.m_extent, new_size))
+            {
+                b.update_handle();
+                return to_pointer(b);
+            }
+            capacity = b.m_extent->m_size;
+            numa_node = p->numa_node();
+        }
+        else
+        {
+            capacity = b.m_segment->block_size();
+            if (new_size <= capacity) return to_pointer(b);
+            numa_node = b.m_segment->numa_node();
+        }
+
+        auto res = allocate(new_size, numa_node);
+        if (!res.get()) return res;
+        std::memcpy(res.get(), b.m_ptr, std::min(capacity, new_size));
+        b.release();
+        return res;
+    }
+
+    // free a range of pointers (e.g. obtained through allocate_bulk): blocks are grouped by
+    // segment and each group is handed back to its pool in a single operation; ranges of up to
+    // free_bulk_buffer_size pointers are sorted on the stack, larger ones spill into a vector
+    template<typename Range>
+    void free_bulk(Range const& range)
+    {
+        std::array<internal_block_type, free_bulk_buffer_size> buffer;
+        std::vector<internal_block_type>                       spill;
+        std::size_t                                            n = 0;
+        for (auto const& p : range)
+        {
+            auto b = static_cast<pointer>(p).m_data.resolve();
+            if (n < buffer.size()) buffer[n++] = b;
+            else
+            {
+                if (spill.empty()) spill.assign(buffer.begin(), buffer.end());
+                spill.push_back(b);
+            }
+        }
+        auto       first = spill.empty() ? buffer.data() : spill.data();
+        auto const end = spill.empty() ? first + n : first + spill.size();
+        std::sort(first, end,
+            [](internal_block_type const& a, internal_block_type const& b)
+            { return a.m_segment < b.m_segment; });
+        while (first != end)
+        {
+            auto s = first->m_segment;
+            auto last = std::find_if(first, end,
+                [s](internal_block_type const& b) { return b.m_segment != s; });
+            if (s) s->get_pool()->free_bulk(first, last);
+            else
+                for (; first != last; ++first) first->release();
+            first = last;
+        }
+    }
+
+    // release empty segments which are kept around because of the decay time (or their pages in
+    // madvise mode)
+    void purge()
+    {
+        for (auto& h : m_heaps) h->purge();
+        for_each_huge_heap([](fixed_size_heap_type& h) { h.purge(); });
+        if (m_extents) m_extents->purge();
+        if (m_segment_arenas) m_segment_arenas->purge();
+    }
+
+    // number of bytes accounted against the memory limits
+    std::size_t memory_usage() const noexcept { return m_budget ? m_budget->used() : 0u; }
+
+    // registered and resident memory per size class
+    heap_stats stats()
+    {
+        heap_stats res;
+        for (auto& h : m_heaps)
+        {
+            if (h->block_size() <= m_config.m_tiny_limit) res.m_tiny += h->stats();
+            else if (h->block_size() <= m_config.m_small_limit)
+                res.m_small += h->stats();
+            else if (h->block_size() <= m_config.m_large_limit)
+                res.m_large += h->stats();
+            else
+                res.m_huge += h->stats();
+        }
+        for_each_huge_heap([&res](fixed_size_heap_type& h) { res.m_huge += h.stats(); });
+        if (m_extents) res.m_huge += m_extents->stats();
+        if (m_segment_arenas) res.m_segment_arenas = m_segment_arenas->stats();
+        return res;
+    }
+
     template<typename T>
     allocator_type<T> get_allocator(std::size_t numa_node) noexcept
     {
@@ -262,7 +780,17 @@ class heap
     std::enable_if_t<!std::is_array<T>::value, unique_ptr<T>> make_unique(std::size_t numa_node,
         Args&&... args)
     {
-        auto ptr = allocate(sizeof(T), numa_node);
+        auto ptr = non_null(allocate<sizeof(T)>(numa_node));
+        new (ptr.get()) T(std::forward<Args>(args)...);
+        return unique_ptr<T>(static_cast<hw_ptr<T, block_type>>(ptr));
+    }
+
+    // scalar version with an alignment stronger than alignof(T), e.g. a cache line
+    template<typename T, typename... Args>
+    std::enable_if_t<!std::is_array<T>::value, unique_ptr<T>> make_unique(
+        std::align_val_t alignment, std::size_t numa_node, Args&&... args)
+    {
+        auto ptr = non_null(allocate(sizeof(T), alignment, numa_node));
         new (ptr.get()) T(std::forward<Args>(args)...);
         return unique_ptr<T>(static_cast<hw_ptr<T, block_type>>(ptr));
     }
@@ -273,11 +801,27 @@ class heap
         std::size_t                                                                  size)
     {
         using U = typename std::remove_extent<T>::type;
-        auto ptr = allocate(sizeof(U) * size, numa_node);
+        auto ptr = non_null(allocate(sizeof(U) * size, numa_node));
+        new (ptr.get()) U[size]();
+        return unique_ptr<T>(static_cast<hw_ptr<U, block_type>>(ptr),
+            heap_delete<T, block_type>{size});
+    }
+
+    // array version with alignment
+    template<typename T>
+    std::enable_if_t<std::is_array<T>::value, unique_ptr<T>> make_unique(
+        std::align_val_t alignment, std::size_t numa_node, std::size_t size)
+    {
+        using U = typename std::remove_extent<T>::type;
+        auto ptr = non_null(allocate(sizeof(U) * size, alignment, numa_node));
         new (ptr.get()) U[size]();
         return unique_ptr<T>(static_cast<hw_ptr<U, block_type>>(ptr),
             heap_delete<T, block_type>{size});
     }
 };
 
+// heap with pointers of the size of a raw pointer, see detail::compact_block_t
+template<typename Context>
+using compact_heap = heap<Context, detail::compact_block_t<Context>>;
+
 } // namespace hwmalloc
@@ -38,6 +38,26 @@ struct heap_config
     static constexpr std::size_t tiny_segment_size_default = 65536u;    // 64KiB
     static constexpr std::size_t small_segment_size_default = 65536u;   // 64KiB
     static constexpr std::size_t large_segment_size_default = 2097152u; // 2MiB
+    static constexpr std::size_t thread_cache_size_default = 0u;        // disabled
+    static constexpr std::size_t thread_cache_max_bytes_default = 1048576u; // 1MiB
+    static constexpr bool        lazy_carving_default = false;
+    static constexpr std::size_t provision_low_watermark_default = 0u;  // disabled
+    static constexpr std::size_t provision_high_watermark_default = 2u;
+    static constexpr std::size_t segment_decay_ms_default = 0u; // release immediately
+    static constexpr bool        madvise_default = false;
+    static constexpr bool        prefault_default = false;
+    static constexpr std::size_t memory_limit_default = 0u; // unlimited
+    static constexpr bool        memory_limit_throws_default = true;
+    static constexpr std::size_t size_class_steps_default = 1u; // powers of two
+    static constexpr bool        huge_extents_default = false;
+    static constexpr std::size_t extent_arena_size_default = 268435456u; // 256MiB
+    static constexpr bool        registration_cache_default = false;
+    static constexpr std::size_t registration_cache_limit_default = 0u; // unlimited
+    static constexpr bool        segment_arenas_default = false;
+    static constexpr std::size_t segment_arena_size_default = 1073741824u; // 1GiB
+    static constexpr std::size_t huge_page_size_default = 0u; // regular pages
+    static constexpr bool        hugetlb_default = false;
+    static constexpr bool        page_map_default = false;
 
     bool                         m_never_free;
     std::size_t                  m_num_reserve_segments;
@@ -53,6 +73,67 @@ struct heap_config
     std::size_t                  m_num_tiny_heaps = m_tiny_limit / m_tiny_increment;
     std::size_t m_num_small_heaps = detail::log2_c(m_small_limit) - detail::log2_c(m_tiny_limit);
     std::size_t m_num_large_heaps = detail::log2_c(m_large_limit) - detail::log2_c(m_small_limit);
+    // per-thread block caches: maximum number of blocks cached per thread and pool (0 disables
+    // the caches), and upper bound on the bytes a single thread may keep in all of its caches
+    std::size_t m_thread_cache_size = thread_cache_size_default;
+    std::size_t m_thread_cache_max_bytes = thread_cache_max_bytes_default;
+    // hand out the blocks of new segments on demand (bump pointer) instead of pushing all of them
+    // to the free stack when the segment is created (opt-in)
+    bool m_lazy_carving = lazy_carving_default;
+    // background segment provisioning: a worker thread keeps between low and high watermark
+    // pre-built and registered spare segments per pool (a low watermark of 0 disables
+    // provisioning)
+    std::size_t m_provision_low_watermark = provision_low_watermark_default;
+    std::size_t m_provision_high_watermark = provision_high_watermark_default;
+    // empty segments beyond the reserve are kept for this many milliseconds before they are
+    // deregistered and returned to the system by the worker thread, also when the heap is idle
+    // (see also heap::purge)
+    std::size_t m_segment_decay_ms = segment_decay_ms_default;
+    // per size class: release the pages of empty segments with madvise instead of releasing the
+    // segments, which keeps the registration alive. Note, that this is only safe with transport
+    // layers which do not pin the physical pages (or which handle faults on registered memory).
+    bool m_tiny_madvise = madvise_default;
+    bool m_small_madvise = madvise_default;
+    bool m_large_madvise = madvise_default;
+    bool m_huge_madvise = madvise_default;
+    // per size class: fault in all pages of new segments when they are built (on the provisioner
+    // thread if provisioning is enabled), such that the first touch of a block does not page
+    // fault. The pages keep their content, this is independent of zeroing.
+    bool m_tiny_prefault = prefault_default;
+    bool m_small_prefault = prefault_default;
+    bool m_large_prefault = prefault_default;
+    bool m_huge_prefault = prefault_default;
+    // memory limits in bytes (0: unlimited) for all segments of a heap and per numa node: exceeding
+    // the soft limit purges unused segments, exceeding a hard limit makes allocations throw
+    // budget_exceeded or return a null pointer (if m_memory_limit_throws is false)
+    std::size_t m_memory_limit = memory_limit_default;
+    std::size_t m_memory_soft_limit = memory_limit_default;
+    std::size_t m_numa_memory_limit = memory_limit_default;
+    bool        m_memory_limit_throws = memory_limit_throws_default;
+    // number of size classes per doubling above the tiny limit (rounded down to a power of two): 1
+    // gives power of two block sizes, 4 limits the internal fragmentation to 25%
+    std::size_t m_size_class_steps = size_class_steps_default;
+    // serve host allocations above the largest size class from page granular extents of large
+    // arenas (registered once, best fit, coalesced on free) instead of a segment per allocation
+    bool        m_huge_extents = huge_extents_default;
+    std::size_t m_extent_arena_size = extent_arena_size_default;
+    // reuse the registrations of user allocations which lie within an earlier registered range
+    // (see detail::registration_cache), unused registrations are evicted in least recently used
+    // order once the registered bytes exceed the limit (0: unlimited)
+    bool        m_registration_cache = registration_cache_default;
+    std::size_t m_registration_cache_limit = registration_cache_limit_default;
+    // carve the host segments of all size classes from large arenas per numa node, which are
+    // registered once, instead of allocating and registering every segment on its own
+    bool        m_segment_arenas = segment_arenas_default;
+    std::size_t m_segment_arena_size = segment_arena_size_default;
+    // back segments and arenas which are a multiple of this size (a power of two, e.g. 2MiB or
+    // 1GiB) by huge pages aligned to it: transparent huge pages, or pages from the hugetlbfs pool
+    // if m_hugetlb is set. Falls back to regular pages when huge pages are not available.
+    std::size_t m_huge_page_size = huge_page_size_default;
+    bool        m_hugetlb = hugetlb_default;
+    // enter the memory of all segments and extents into the page map (see detail::page_map), which
+    // heap::lookup and heap::free(void*) rely on. Compact heaps always use the page map.
+    bool m_page_map = page_map_default;
 
     heap_config(bool never_free, std::size_t num_reserve_segments, std::size_t tiny_limit,
         std::size_t small_limit, std::size_t large_limit, std::size_t tiny_segment_size,
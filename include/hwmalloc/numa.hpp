@@ -34,6 +34,12 @@ class numa_tools
         size_type const  size = 0u;
         index_type const node = 0u;
         bool const       use_numa_free = true;
+        // size of the pages backing the allocation (huge pages, see allocate_huge)
+        size_type const page_size = numa_tools::page_size_;
+        // mapped with mmap, released with munmap
+        bool const use_munmap = false;
+        // fresh pages from the system, which are known to be zero-filled
+        bool const zeroed = false;
 
         operator bool() const noexcept { return (bool)ptr; }
     };
@@ -119,7 +125,22 @@ class numa_tools
     allocation allocate(size_type num_pages) const noexcept;
     allocation allocate(size_type num_pages, index_type node) const noexcept;
     allocation allocate_malloc(size_type num_pages) const noexcept;
+    // allocate size bytes aligned to huge_page_size and backed by huge pages: taken from the
+    // hugetlbfs pool if hugetlb is set and pages of this size are reserved, otherwise transparent
+    // huge pages are requested. Falls back to allocate (regular pages) if size is not a multiple
+    // of huge_page_size (a power of two) or huge pages are not supported at all. The page size of
+    // the result tells which kind of pages was used.
+    allocation allocate_huge(size_type size, index_type node, size_type huge_page_size,
+        bool hugetlb) const noexcept;
     void       free(allocation const& a) const noexcept;
+    // give the physical pages within [ptr, ptr+size) back to the OS while keeping the address range
+    // mapped, returns the number of bytes released (only whole pages of size page_size, the page
+    // size of the allocation, are released)
+    size_type release_pages(void* ptr, size_type size, size_type page_size = page_size_) const
+        noexcept;
+    // fault in the pages within [ptr, ptr+size) for writing without changing their content
+    void populate_pages(void* ptr, size_type size, size_type page_size = page_size_) const
+        noexcept;
     index_type get_node(void* ptr) const noexcept;
 
   private:
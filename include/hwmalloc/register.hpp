@@ -10,6 +10,7 @@
 #pragma once
 
 #include <cstddef>
+#include <type_traits>
 #include <utility>
 
 namespace hwmalloc
@@ -84,4 +85,15 @@ namespace
 constexpr auto const& register_memory = static_const_v<detail::register_fn>;
 }
 
+// Handles are computed once per block when a segment is created and are stored with the block,
+// i.e. in the free lists and in every fancy pointer. If get_handle is cheap, e.g. a base key plus
+// an offset, this trait can be specialized to derive the handle on demand from the region instead:
+//
+//     template<>
+//     struct hwmalloc::lazy_handles<my_context> : std::true_type {};
+template<typename Context>
+struct lazy_handles : std::false_type
+{
+};
+
 } // namespace hwmalloc
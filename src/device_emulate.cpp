@@ -34,7 +34,7 @@ set_device_id(int /*id*/)
 void*
 device_malloc(std::size_t size)
 {
-    auto ptr = std::memset(std::malloc(size), 0, size);
+    auto ptr = std::malloc(size);
     HWMALLOC_LOG("allocating", size, "bytes using emulate (std::malloc):", (std::uintptr_t)ptr);
     return ptr;
 }
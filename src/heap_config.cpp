@@ -105,21 +105,79 @@ heap_config::heap_config(bool never_free, std::size_t num_reserve_segments, std:
 heap_config const&
 get_default_heap_config()
 {
-    static heap_config config{
-        detail::get_env<bool>("HWMALLOC_NEVER_FREE", heap_config::never_free_default),
-        detail::get_env<std::size_t>("HWMALLOC_NUM_RESERVE_SEGMENTS",
-            heap_config::num_reserve_segments_default),
-        detail::get_env<std::size_t>("HWMALLOC_TINY_LIMIT", heap_config::tiny_limit_default),
-        detail::get_env<std::size_t>("HWMALLOC_SMALL_LIMIT", heap_config::small_limit_default),
-        detail::get_env<std::size_t>("HWMALLOC_LARGE_LIMIT", heap_config::large_limit_default),
-        detail::get_env<std::size_t>("HWMALLOC_TINY_SEGMENT_SIZE",
-            heap_config::tiny_segment_size_default),
-        detail::get_env<std::size_t>("HWMALLOC_SMALL_SEGMENT_SIZE",
-            heap_config::small_segment_size_default),
-        detail::get_env<std::size_t>("HWMALLOC_LARGE_SEGMENT_SIZE",
-            heap_config::large_segment_size_default)
+    static heap_config config = []()
+    {
+        heap_config c{
+            detail::get_env<bool>("HWMALLOC_NEVER_FREE", heap_config::never_free_default),
+            detail::get_env<std::size_t>("HWMALLOC_NUM_RESERVE_SEGMENTS",
+                heap_config::num_reserve_segments_default),
+            detail::get_env<std::size_t>("HWMALLOC_TINY_LIMIT", heap_config::tiny_limit_default),
+            detail::get_env<std::size_t>("HWMALLOC_SMALL_LIMIT", heap_config::small_limit_default),
+            detail::get_env<std::size_t>("HWMALLOC_LARGE_LIMIT", heap_config::large_limit_default),
+            detail::get_env<std::size_t>("HWMALLOC_TINY_SEGMENT_SIZE",
+                heap_config::tiny_segment_size_default),
+            detail::get_env<std::size_t>("HWMALLOC_SMALL_SEGMENT_SIZE",
+                heap_config::small_segment_size_default),
+            detail::get_env<std::size_t>("HWMALLOC_LARGE_SEGMENT_SIZE",
+                heap_config::large_segment_size_default)};
 
-    };
+        // optional features which are not part of the constructor
+        c.m_thread_cache_size = detail::get_env<std::size_t>("HWMALLOC_THREAD_CACHE_SIZE",
+            heap_config::thread_cache_size_default);
+        c.m_thread_cache_max_bytes = detail::get_env<std::size_t>(
+            "HWMALLOC_THREAD_CACHE_MAX_BYTES", heap_config::thread_cache_max_bytes_default);
+        c.m_lazy_carving =
+            detail::get_env<bool>("HWMALLOC_LAZY_CARVING", heap_config::lazy_carving_default);
+        c.m_provision_low_watermark = detail::get_env<std::size_t>(
+            "HWMALLOC_PROVISION_LOW_WATERMARK", heap_config::provision_low_watermark_default);
+        c.m_provision_high_watermark = detail::get_env<std::size_t>(
+            "HWMALLOC_PROVISION_HIGH_WATERMARK", heap_config::provision_high_watermark_default);
+        c.m_segment_decay_ms = detail::get_env<std::size_t>("HWMALLOC_SEGMENT_DECAY_MS",
+            heap_config::segment_decay_ms_default);
+        c.m_tiny_madvise =
+            detail::get_env<bool>("HWMALLOC_TINY_MADVISE", heap_config::madvise_default);
+        c.m_small_madvise =
+            detail::get_env<bool>("HWMALLOC_SMALL_MADVISE", heap_config::madvise_default);
+        c.m_large_madvise =
+            detail::get_env<bool>("HWMALLOC_LARGE_MADVISE", heap_config::madvise_default);
+        c.m_huge_madvise =
+            detail::get_env<bool>("HWMALLOC_HUGE_MADVISE", heap_config::madvise_default);
+        c.m_tiny_prefault =
+            detail::get_env<bool>("HWMALLOC_TINY_PREFAULT", heap_config::prefault_default);
+        c.m_small_prefault =
+            detail::get_env<bool>("HWMALLOC_SMALL_PREFAULT", heap_config::prefault_default);
+        c.m_large_prefault =
+            detail::get_env<bool>("HWMALLOC_LARGE_PREFAULT", heap_config::prefault_default);
+        c.m_huge_prefault =
+            detail::get_env<bool>("HWMALLOC_HUGE_PREFAULT", heap_config::prefault_default);
+        c.m_memory_limit = detail::get_env<std::size_t>("HWMALLOC_MEMORY_LIMIT",
+            heap_config::memory_limit_default);
+        c.m_memory_soft_limit = detail::get_env<std::size_t>("HWMALLOC_MEMORY_SOFT_LIMIT",
+            heap_config::memory_limit_default);
+        c.m_numa_memory_limit = detail::get_env<std::size_t>("HWMALLOC_NUMA_MEMORY_LIMIT",
+            heap_config::memory_limit_default);
+        c.m_memory_limit_throws = detail::get_env<bool>("HWMALLOC_MEMORY_LIMIT_THROWS",
+            heap_config::memory_limit_throws_default);
+        c.m_size_class_steps = detail::get_env<std::size_t>("HWMALLOC_SIZE_CLASS_STEPS",
+            heap_config::size_class_steps_default);
+        c.m_huge_extents =
+            detail::get_env<bool>("HWMALLOC_HUGE_EXTENTS", heap_config::huge_extents_default);
+        c.m_extent_arena_size = detail::get_env<std::size_t>("HWMALLOC_EXTENT_ARENA_SIZE",
+            heap_config::extent_arena_size_default);
+        c.m_registration_cache = detail::get_env<bool>("HWMALLOC_REGISTRATION_CACHE",
+            heap_config::registration_cache_default);
+        c.m_registration_cache_limit = detail::get_env<std::size_t>(
+            "HWMALLOC_REGISTRATION_CACHE_LIMIT", heap_config::registration_cache_limit_default);
+        c.m_segment_arenas =
+            detail::get_env<bool>("HWMALLOC_SEGMENT_ARENAS", heap_config::segment_arenas_default);
+        c.m_segment_arena_size = detail::get_env<std::size_t>("HWMALLOC_SEGMENT_ARENA_SIZE",
+            heap_config::segment_arena_size_default);
+        c.m_huge_page_size = detail::get_env<std::size_t>("HWMALLOC_HUGE_PAGE_SIZE",
+            heap_config::huge_page_size_default);
+        c.m_hugetlb = detail::get_env<bool>("HWMALLOC_HUGETLB", heap_config::hugetlb_default);
+        c.m_page_map = detail::get_env<bool>("HWMALLOC_PAGE_MAP", heap_config::page_map_default);
+        return c;
+    }();
 
     return config;
 }
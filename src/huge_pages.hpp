@@ -0,0 +1,131 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/log.hpp>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace hwmalloc
+{
+namespace detail
+{
+struct huge_mapping
+{
+    void*       ptr = nullptr;
+    std::size_t page_size = 0u;
+};
+
+// size of the transparent huge pages (the PMD size, 2MiB on x86_64), 0 if they are disabled
+inline std::size_t
+transparent_huge_page_size() noexcept
+{
+    static const std::size_t s = []() -> std::size_t
+    {
+        std::string   mode;
+        std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+        if (!std::getline(enabled, mode) || mode.find("[never]") != std::string::npos) return 0u;
+        std::size_t   res = 0u;
+        std::ifstream f("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+        if (!(f >> res) || res == 0u) res = 2097152u;
+        return res;
+    }();
+    return s;
+}
+
+// number of free pages in the hugetlbfs pool of pages of size page_size on a numa node
+inline std::size_t
+free_huge_pages(std::size_t page_size, std::size_t node) noexcept
+{
+    std::size_t   res = 0u;
+    std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) +
+                    "/hugepages/hugepages-" + std::to_string(page_size / 1024) +
+                    "kB/free_hugepages");
+    return (f >> res) ? res : 0u;
+}
+
+// Anonymous mapping of bytes (a multiple of alignment, which is a power of two) aligned to
+// alignment. With hugetlb the pages are taken from the hugetlbfs pool of pages of size alignment;
+// if none are reserved (or otherwise) transparent huge pages are requested with madvise. The page
+// size of the result is the system page size when transparent huge pages are not supported either.
+inline huge_mapping
+map_huge(std::size_t bytes, std::size_t alignment, bool hugetlb) noexcept
+{
+    const std::size_t system_page_size = sysconf(_SC_PAGESIZE);
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+    if (hugetlb)
+    {
+        // the page size is encoded as its logarithm in the flags
+        const int log_size = __builtin_ctzl(alignment);
+        void*     ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (log_size << MAP_HUGE_SHIFT), -1, 0);
+        if (ptr != MAP_FAILED) return {ptr, alignment};
+    }
+#else
+    (void)hugetlb;
+#endif
+    // over-map by the alignment and trim both ends
+    void* raw = mmap(nullptr, bytes + alignment, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return {};
+    const auto first = reinterpret_cast<std::uintptr_t>(raw);
+    const auto aligned = (first + alignment - 1) / alignment * alignment;
+    if (aligned > first) munmap(raw, aligned - first);
+    if (first + alignment > aligned)
+        munmap(reinterpret_cast<void*>(aligned + bytes), first + alignment - aligned);
+    void* ptr = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+    const auto thp_size = transparent_huge_page_size();
+    if (thp_size > 0u && madvise(ptr, bytes, MADV_HUGEPAGE) == 0)
+        return {ptr, std::min(alignment, thp_size)};
+#endif
+    return {ptr, system_page_size};
+}
+
+// give the pages of size page_size which lie entirely within [ptr, ptr + size) back to the OS,
+// returns the number of bytes released
+inline std::size_t
+release_pages(void* ptr, std::size_t size, std::size_t page_size) noexcept
+{
+    const auto first = (reinterpret_cast<std::uintptr_t>(ptr) + page_size - 1) / page_size;
+    const auto last = (reinterpret_cast<std::uintptr_t>(ptr) + size) / page_size;
+    if (last <= first) return 0u;
+    const auto n = (last - first) * page_size;
+    if (madvise(reinterpret_cast<void*>(first * page_size), n, MADV_DONTNEED) != 0) return 0u;
+    HWMALLOC_LOG("releasing ", n, "bytes using madvise:", first * page_size);
+    return n;
+}
+
+// fault in the pages of size page_size overlapping [ptr, ptr + size), keeping their content
+inline void
+populate_pages(void* ptr, std::size_t size, std::size_t page_size) noexcept
+{
+    if (size == 0u) return;
+#ifdef MADV_POPULATE_WRITE
+    if (madvise(ptr, size, MADV_POPULATE_WRITE) == 0)
+    {
+        HWMALLOC_LOG("populating", size, "bytes using madvise:", (std::uintptr_t)ptr);
+        return;
+    }
+#endif
+    // older kernels: touch every page, writing back what was read
+    auto p = static_cast<volatile char*>(ptr);
+    for (std::size_t i = 0; i < size; i += page_size) p[i] = p[i];
+    p[size - 1] = p[size - 1];
+    HWMALLOC_LOG("populating", size, "bytes by touching:", (std::uintptr_t)ptr);
+}
+
+} // namespace detail
+} // namespace hwmalloc
@@ -9,11 +9,14 @@
  */
 #include <hwmalloc/numa.hpp>
 #include <hwmalloc/log.hpp>
+#include "./huge_pages.hpp"
 #include <numaif.h>
 #include <numa.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
 #include <cstdint>
 #include <iomanip>
 #include <sys/sysinfo.h>
@@ -141,20 +144,42 @@ numa_tools::allocate(size_type num_pages, index_type node) const noexcept
         << reinterpret_cast<uintptr_t>(ptr);
     HWMALLOC_LOG("allocating", num_pages * page_size_, "bytes using numa_alloc:", tmp.str());
 #endif
-    return {ptr, num_pages * page_size_, node};
+    return {ptr, num_pages * page_size_, node, true, page_size_, false, true};
 }
 
 numa_tools::allocation
 numa_tools::allocate_malloc(size_type num_pages) const noexcept
 {
-    void* ptr = std::calloc(num_pages, page_size_);
-    //void* ptr = std::malloc(num_pages * page_size_);
+    // page aligned, so that blocks are aligned to their size (up to the page size); the memory is
+    // not zero-filled
+    void* ptr = std::aligned_alloc(page_size_, num_pages * page_size_);
     if (!ptr) return {};
     HWMALLOC_LOG("allocating", num_pages * page_size_,
         "bytes using std::malloc:", (std::uintptr_t)ptr);
     return {ptr, num_pages * page_size_, get_node(ptr), false};
 }
 
+numa_tools::allocation
+numa_tools::allocate_huge(size_type size, index_type node, size_type huge_page_size,
+    bool hugetlb) const noexcept
+{
+    const auto num_pages = (size + page_size_ - 1) / page_size_;
+    if (huge_page_size <= page_size_ || (huge_page_size & (huge_page_size - 1)) != 0u ||
+        size % huge_page_size != 0u || !can_allocate_on(node))
+        return allocate(num_pages, node);
+    // mmap reserves hugetlbfs pages from the pool of all nodes: the first touch of pages bound to
+    // a node which has run out of them raises SIGBUS, fall back to transparent huge pages instead
+    if (hugetlb && detail::free_huge_pages(huge_page_size, node) < size / huge_page_size)
+        hugetlb = false;
+    const auto m = detail::map_huge(size, huge_page_size, hugetlb);
+    if (!m.ptr) return allocate(num_pages, node);
+    // the pages are placed on the node when they are first touched
+    numa_tonode_memory(m.ptr, size, node);
+    HWMALLOC_LOG("allocating", size, "bytes using mmap with page size", m.page_size, ":",
+        (std::uintptr_t)m.ptr);
+    return {m.ptr, size, node, false, m.page_size, true, true};
+}
+
 numa_tools::index_type
 numa_tools::get_node(void* ptr) const noexcept
 {
@@ -174,7 +199,12 @@ numa_tools::free(numa_tools::allocation const& a) const noexcept
 {
     if (a)
     {
-        if (a.use_numa_free)
+        if (a.use_munmap)
+        {
+            HWMALLOC_LOG("freeing   ", a.size, "bytes using munmap:", (std::uintptr_t)a.ptr);
+            munmap(a.ptr, a.size);
+        }
+        else if (a.use_numa_free)
         {
             HWMALLOC_LOG("freeing   ", a.size, "bytes using numa_free:", (std::uintptr_t)a.ptr);
             numa_free(a.ptr, a.size);
@@ -187,6 +217,18 @@ numa_tools::free(numa_tools::allocation const& a) const noexcept
     }
 }
 
+numa_tools::size_type
+numa_tools::release_pages(void* ptr, size_type size, size_type page_size) const noexcept
+{
+    return detail::release_pages(ptr, size, page_size);
+}
+
+void
+numa_tools::populate_pages(void* ptr, size_type size, size_type page_size) const noexcept
+{
+    detail::populate_pages(ptr, size, page_size);
+}
+
 // factory function
 // only available from within this translation unit
 numa_tools
@@ -9,8 +9,12 @@
  */
 #include <hwmalloc/numa.hpp>
 #include <hwmalloc/log.hpp>
+#include "./huge_pages.hpp"
 #include <unistd.h>
+#include <sys/mman.h>
 #include <cstdlib>
+#include <cstring>
+#include <cstdint>
 
 namespace hwmalloc
 {
@@ -61,14 +65,30 @@ numa_tools::allocate(size_type num_pages, index_type /*node*/) const noexcept
 numa_tools::allocation
 numa_tools::allocate_malloc(size_type num_pages) const noexcept
 {
-    void* ptr = std::calloc(num_pages, page_size_);
-    //void* ptr = std::malloc(num_pages * page_size_);
+    // page aligned, so that blocks are aligned to their size (up to the page size); the memory is
+    // not zero-filled
+    void* ptr = std::aligned_alloc(page_size_, num_pages * page_size_);
     if (!ptr) return {};
     HWMALLOC_LOG("allocating", num_pages * page_size_,
         "bytes using std::malloc:", (std::uintptr_t)ptr);
     return {ptr, num_pages * page_size_, get_node(ptr), false};
 }
 
+numa_tools::allocation
+numa_tools::allocate_huge(size_type size, index_type node, size_type huge_page_size,
+    bool hugetlb) const noexcept
+{
+    const auto num_pages = (size + page_size_ - 1) / page_size_;
+    if (huge_page_size <= page_size_ || (huge_page_size & (huge_page_size - 1)) != 0u ||
+        size % huge_page_size != 0u)
+        return allocate(num_pages, node);
+    const auto m = detail::map_huge(size, huge_page_size, hugetlb);
+    if (!m.ptr) return allocate(num_pages, node);
+    HWMALLOC_LOG("allocating", size, "bytes using mmap with page size", m.page_size, ":",
+        (std::uintptr_t)m.ptr);
+    return {m.ptr, size, get_node(m.ptr), false, m.page_size, true, true};
+}
+
 numa_tools::index_type
 numa_tools::get_node(void* /*ptr*/) const noexcept
 {
@@ -80,11 +100,31 @@ numa_tools::free(numa_tools::allocation const& a) const noexcept
 {
     if (a)
     {
-        HWMALLOC_LOG("freeing   ", a.size, "bytes using std::free:", (std::uintptr_t)a.ptr);
-        std::free(a.ptr);
+        if (a.use_munmap)
+        {
+            HWMALLOC_LOG("freeing   ", a.size, "bytes using munmap:", (std::uintptr_t)a.ptr);
+            munmap(a.ptr, a.size);
+        }
+        else
+        {
+            HWMALLOC_LOG("freeing   ", a.size, "bytes using std::free:", (std::uintptr_t)a.ptr);
+            std::free(a.ptr);
+        }
     }
 }
 
+numa_tools::size_type
+numa_tools::release_pages(void* ptr, size_type size, size_type page_size) const noexcept
+{
+    return detail::release_pages(ptr, size, page_size);
+}
+
+void
+numa_tools::populate_pages(void* ptr, size_type size, size_type page_size) const noexcept
+{
+    detail::populate_pages(ptr, size, page_size);
+}
+
 // factory function
 // only available from within this translation unit
 numa_tools
@@ -0,0 +1,86 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#pragma once
+
+#include <hwmalloc/register.hpp>
+
+#include <iostream>
+#include <utility>
+
+struct context
+{
+    int m = 42;
+    context() { std::cout << "context constructor" << std::endl; }
+    ~context() { std::cout << "context destructor" << std::endl; }
+
+    struct region
+    {
+        struct handle_type
+        {
+            void* ptr;
+        };
+
+        void* ptr = nullptr;
+
+        region(void* p) noexcept
+        : ptr{p}
+        {
+        }
+
+        region(region const&) = delete;
+
+        region(region&& other) noexcept
+        : ptr{std::exchange(other.ptr, nullptr)}
+        {
+        }
+
+        ~region()
+        {
+            if (ptr) std::cout << "    region destructor" << std::endl;
+        }
+
+        handle_type get_handle(std::size_t offset, std::size_t /*size*/) const noexcept
+        {
+            return {(void*)((char*)ptr + offset)};
+        }
+    };
+};
+
+inline auto
+register_memory(context&, void* ptr, std::size_t)
+{
+    return context::region{ptr};
+}
+
+// handles are derived on demand from the regions
+struct lazy_context : context
+{
+};
+
+namespace hwmalloc
+{
+template<>
+struct lazy_handles<lazy_context> : std::true_type
+{
+};
+} // namespace hwmalloc
+
+// counts the registrations
+struct counting_context : context
+{
+    int m_registrations = 0;
+};
+
+inline auto
+register_memory(counting_context& c, void* ptr, std::size_t)
+{
+    ++c.m_registrations;
+    return context::region{ptr};
+}
@@ -79,3 +79,20 @@ TEST(heap, construction)
     std::cout << ptr.device_ptr() << std::endl;
     h.free(ptr);
 }
+
+TEST(heap, compact_pointer)
+{
+    using heap_t = hwmalloc::compact_heap<context>;
+
+    context c;
+
+    heap_t h(&c);
+
+    // the device mirror is recovered from the segment
+    auto ptr = h.allocate(64, 0, 0);
+    EXPECT_TRUE(ptr.on_device());
+    EXPECT_NE(ptr.device_ptr(), nullptr);
+    auto q = static_cast<heap_t::typed_pointer<char>>(ptr) + 8;
+    EXPECT_EQ(q.device_ptr(), (char*)ptr.device_ptr() + 8);
+    h.free(ptr);
+}
@@ -0,0 +1,728 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <gtest/gtest.h>
+
+#include <hwmalloc/heap.hpp>
+
+#include <thread>
+#include <set>
+#include <cstring>
+#include <array>
+
+#include "./context.hpp"
+
+TEST(heap, allocate_static_size)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    heap_t h(&c);
+
+    // static and dynamic sizes are served by the same fixed_size_heap: the blocks of a new segment
+    // are handed out in address order
+    auto p0 = h.allocate<24>(0);
+    auto p1 = h.allocate(24, 0);
+    auto p2 = h.allocate<17>(0);
+    EXPECT_EQ((char*)p1.get() - (char*)p0.get(), 24);
+    EXPECT_EQ((char*)p2.get() - (char*)p1.get(), 24);
+
+    // single objects (e.g. container nodes) allocated through the allocator
+    auto a = h.template get_allocator<std::array<double, 3>>(0);
+    auto s0 = a.allocate(1);
+    EXPECT_EQ((char*)s0.get() - (char*)p2.get(), 24);
+    a.deallocate(s0, 1);
+
+    auto q0 = h.allocate<3000>(0);
+    auto q1 = h.allocate(4096, 0);
+    EXPECT_EQ((char*)q1.get() - (char*)q0.get(), 4096);
+    // the second call takes the cached heap
+    auto q2 = h.allocate<3000>(0);
+    EXPECT_EQ((char*)q2.get() - (char*)q1.get(), 4096);
+
+    // the cache is per heap: with finer classes the same size is served by a smaller class
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_size_class_steps = 4;
+    heap_t g(&c, config);
+    auto   g0 = g.allocate<3000>(0);
+    auto   g1 = g.allocate(3072, 0);
+    EXPECT_EQ((char*)g1.get() - (char*)g0.get(), 3072);
+    g.free(g0);
+    g.free(g1);
+
+    // sizes above the largest class are not cached when they are served by extents
+    config.m_huge_extents = true;
+    heap_t e(&c, config);
+    for (int i = 0; i < 2; ++i)
+    {
+        auto x = e.allocate<(1u << 23)>(0);
+        EXPECT_TRUE(x.get() != nullptr);
+        EXPECT_EQ(e.stats().m_huge.m_registered_bytes, config.m_extent_arena_size);
+        e.free(x);
+    }
+
+    // beyond the largest class
+    auto r = h.allocate<(1u << 23)>(0);
+    std::memset(r.get(), 0, 1u << 23);
+
+    h.free(p0);
+    h.free(p1);
+    h.free(p2);
+    h.free(q0);
+    h.free(q1);
+    h.free(q2);
+    h.free(r);
+
+    auto u = h.make_unique<std::array<int, 5>>(0);
+    EXPECT_EQ(u->size(), 5u);
+}
+
+TEST(heap, aligned_allocation)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    for (std::size_t steps : {1u, 4u})
+    {
+        auto config = hwmalloc::get_default_heap_config();
+        config.m_size_class_steps = steps;
+        heap_t h(&c, config);
+
+        std::vector<heap_t::pointer> ptrs;
+        for (std::size_t alignment = 8; alignment <= hwmalloc::numa().page_size(); alignment *= 2)
+            for (std::size_t size : {0ul, 1ul, 24ul, 100ul, 1000ul, 5000ul, 70000ul, 3000000ul})
+                for (int i = 0; i < 3; ++i)
+                {
+                    auto p = h.allocate(size, std::align_val_t{alignment}, 0);
+                    EXPECT_EQ((std::uintptr_t)p.get() % alignment, 0u);
+                    EXPECT_EQ(p.handle().ptr, p.get());
+                    ptrs.push_back(p);
+                }
+        for (auto& p : ptrs) h.free(p);
+
+        EXPECT_THROW(h.allocate(64, std::align_val_t{48}, 0), std::runtime_error);
+        EXPECT_THROW(h.allocate(64, std::align_val_t{2 * hwmalloc::numa().page_size()}, 0),
+            std::runtime_error);
+
+        auto u = h.make_unique<double>(std::align_val_t{64}, 0, 42.0);
+        EXPECT_EQ((std::uintptr_t)u.get().get() % 64, 0u);
+        EXPECT_EQ(*u, 42.0);
+        auto v = h.make_unique<float[]>(std::align_val_t{256}, 0, 17);
+        EXPECT_EQ((std::uintptr_t)v.get().get() % 256, 0u);
+    }
+}
+
+TEST(heap, bulk)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    heap_t h(&c);
+
+    for (std::size_t size : {8ul, 1000ul, 100000ul, 4194304ul})
+    {
+        std::vector<heap_t::pointer> ptrs;
+        h.allocate_bulk(size, 0, 100, std::back_inserter(ptrs));
+        EXPECT_EQ(ptrs.size(), 100u);
+        std::set<void*> unique;
+        for (auto& p : ptrs)
+        {
+            EXPECT_TRUE(p.get() != nullptr);
+            unique.insert(p.get());
+        }
+        EXPECT_EQ(unique.size(), 100u);
+        // mix in a single allocation of a different size class
+        ptrs.push_back(h.allocate(size * 2, 0));
+        h.free_bulk(ptrs);
+    }
+
+    // ranges which fit into the stack buffer of free_bulk and which just exceed it
+    for (std::size_t count : {std::size_t(3), heap_t::free_bulk_buffer_size,
+             heap_t::free_bulk_buffer_size + 1})
+    {
+        std::vector<heap_t::pointer> ptrs;
+        h.allocate_bulk(64, 0, count, std::back_inserter(ptrs));
+        ptrs.push_back(h.allocate(100000, 0));
+        h.free_bulk(ptrs);
+    }
+}
+
+TEST(heap, provisioning)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_provision_low_watermark = 1;
+    config.m_provision_high_watermark = 2;
+    heap_t h(&c, config);
+
+    for (std::size_t size : {8ul, 1000ul, 100000ul, 4194304ul})
+    {
+        std::vector<heap_t::pointer> ptrs;
+        for (int i = 0; i < 100; ++i) ptrs.push_back(h.allocate(size, 0));
+        for (auto& p : ptrs) h.free(p);
+    }
+}
+
+TEST(heap, purge)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_segment_decay_ms = 60000;
+    heap_t h(&c, config);
+
+    for (std::size_t size : {8ul, 1000ul, 100000ul, 4194304ul})
+    {
+        std::vector<heap_t::pointer> ptrs;
+        for (int i = 0; i < 100; ++i) ptrs.push_back(h.allocate(size, 0));
+        for (auto& p : ptrs) h.free(p);
+    }
+    h.purge();
+}
+
+TEST(heap, stats)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_small_madvise = true;
+    heap_t h(&c, config);
+
+    std::vector<heap_t::pointer> ptrs;
+    for (std::size_t size : {8ul, 1000ul, 100000ul, 4194304ul}) ptrs.push_back(h.allocate(size, 0));
+    auto s = h.stats();
+    EXPECT_EQ(s.m_tiny.m_num_segments, 1u);
+    EXPECT_EQ(s.m_small.m_num_segments, 1u);
+    EXPECT_EQ(s.m_large.m_num_segments, 1u);
+    EXPECT_EQ(s.m_huge.m_num_segments, 1u);
+    EXPECT_EQ(s.total().m_registered_bytes, s.m_tiny.m_registered_bytes +
+                                                s.m_small.m_registered_bytes +
+                                                s.m_large.m_registered_bytes +
+                                                s.m_huge.m_registered_bytes);
+    for (auto& p : ptrs) h.free(p);
+    h.purge();
+}
+
+TEST(heap, huge_concurrent)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    heap_t h(&c);
+
+    // all threads race for the creation of the same huge heaps
+    const std::size_t        num_threads = 4;
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < num_threads; ++t)
+        threads.emplace_back(
+            [&h]()
+            {
+                for (int i = 0; i < 20; ++i)
+                    for (std::size_t size : {5000000ul, 8388608ul, 9000000ul, 33554432ul})
+                    {
+                        auto p = h.allocate(size, 0);
+                        std::memset(p.get(), 0, size);
+                        h.free(p);
+                    }
+            });
+    for (auto& t : threads) t.join();
+
+    // one heap per class (8MiB, 16MiB, 32MiB), each with at most one segment per thread
+    auto s = h.stats();
+    EXPECT_GE(s.m_huge.m_num_segments, 3u);
+    EXPECT_LE(s.m_huge.m_num_segments, 3u * num_threads);
+    h.purge();
+}
+
+TEST(heap, huge_extents)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    const std::size_t MiB = 1048576u;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = 128 * MiB;
+    heap_t h(&c, config);
+
+    // page granular extents of a single arena, handed out in address order
+    auto p0 = h.allocate(33 * MiB, 0);
+    auto p1 = h.allocate(40 * MiB + 1, 0);
+    auto p2 = h.allocate(20 * MiB, 0);
+    EXPECT_EQ((char*)p1.get() - (char*)p0.get(), 33 * MiB);
+    EXPECT_EQ((char*)p2.get() - (char*)p1.get(), 40 * MiB + hwmalloc::numa().page_size());
+    EXPECT_EQ(p1.handle().ptr, p1.get());
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 1u);
+    EXPECT_EQ(h.stats().m_huge.m_registered_bytes, 128 * MiB);
+    std::memset(p1.get(), 0, 40 * MiB + 1);
+
+    // freed neighbours are coalesced
+    h.free(p1);
+    h.free(p0);
+    auto p3 = h.allocate(65 * MiB, 0);
+    EXPECT_EQ(p3.get(), p0.get());
+
+    // best fit: the remaining 8MiB gap is preferred over the 35MiB tail of the arena
+    auto p4 = h.allocate(6 * MiB, 0);
+    EXPECT_EQ((char*)p4.get(), (char*)p3.get() + 65 * MiB);
+
+    // allocations larger than an arena get their own, which is released when it becomes empty
+    auto p5 = h.allocate(200 * MiB, 0);
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 2u);
+    h.free(p5);
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 1u);
+
+    // the last arena is kept until purge
+    h.free(p2);
+    h.free(p3);
+    h.free(p4);
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 1u);
+    h.purge();
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 0u);
+}
+
+TEST(heap, reallocate)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    const std::size_t MiB = 1048576u;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = 64 * MiB;
+    heap_t h(&c, config);
+
+    // in place while the size class has room
+    auto p = h.allocate(200, 0);
+    std::memset(p.get(), 7, 200);
+    auto q = h.reallocate(p, 256);
+    EXPECT_EQ(q.get(), p.get());
+
+    // copied to a larger class
+    auto r = h.reallocate(q, 1000);
+    EXPECT_NE(r.get(), q.get());
+    EXPECT_EQ(((unsigned char*)r.get())[199], 7);
+
+    // into an extent, which then grows into the free space behind it
+    auto e = h.reallocate(r, 5 * MiB);
+    EXPECT_EQ(((unsigned char*)e.get())[199], 7);
+    auto f = h.reallocate(e, 20 * MiB);
+    EXPECT_EQ(f.get(), e.get());
+    std::memset(f.get(), 0, 20 * MiB);
+
+    // blocked by a neighbour: moved to another extent
+    auto g = h.allocate(5 * MiB, 0);
+    EXPECT_EQ((char*)g.get(), (char*)f.get() + 20 * MiB);
+    auto k = h.reallocate(f, 30 * MiB);
+    EXPECT_NE(k.get(), f.get());
+    EXPECT_EQ(h.stats().m_huge.m_num_segments, 1u);
+
+    h.free(g);
+    h.free(k);
+
+    std::vector<double> data(10);
+    auto                u = h.register_user_allocation(data.data(), 10 * sizeof(double));
+    EXPECT_THROW(h.reallocate(u, 1000), std::runtime_error);
+    h.free(u);
+}
+
+TEST(heap, compact_pointer)
+{
+    using heap_t = hwmalloc::compact_heap<context>;
+
+    static_assert(sizeof(heap_t::pointer) == sizeof(void*), "compact pointer");
+    static_assert(sizeof(heap_t::typed_pointer<int>) == sizeof(int*), "compact pointer");
+
+    context c;
+
+    const std::size_t MiB = 1048576u;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = 64 * MiB;
+    heap_t h(&c, config);
+
+    // the handle is recovered from the segment, interior pointers resolve to their block
+    for (std::size_t size : {8u, 200u, 5000u, 3u * 1048576u})
+    {
+        auto p = h.allocate(size, 0);
+        EXPECT_EQ(p.handle().ptr, p.get());
+        auto q = static_cast<heap_t::typed_pointer<int>>(p) + 1;
+        EXPECT_EQ(q.handle().ptr, p.get());
+        h.free(p);
+    }
+
+    // extents
+    auto e = h.allocate(40 * MiB, 0);
+    EXPECT_EQ(e.handle().ptr, e.get());
+    auto e2 = h.reallocate(e, 41 * MiB);
+    EXPECT_EQ(e2.get(), e.get());
+    auto f = h.allocate(20 * MiB, 0);
+    EXPECT_EQ((char*)f.get(), (char*)e.get() + 41 * MiB);
+    h.free(e2);
+    h.free(f);
+
+    // containers
+    std::vector<int, heap_t::allocator_type<int>> v(h.get_allocator<int>(0));
+    for (int i = 0; i < 1000; ++i) v.push_back(i);
+    EXPECT_EQ(v[999], 999);
+
+    std::vector<heap_t::pointer> ptrs;
+    h.allocate_bulk(32, 0, 100, std::back_inserter(ptrs));
+    for (auto const& p : ptrs) EXPECT_EQ(p.handle().ptr, p.get());
+    h.free_bulk(ptrs);
+}
+
+TEST(heap, lookup)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    const std::size_t MiB = 1048576u;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = 64 * MiB;
+    config.m_page_map = true;
+    heap_t h(&c, config);
+
+    for (std::size_t size : {24u, 700u, 40000u, 3u * 1048576u, 10u * 1048576u})
+    {
+        auto p = h.allocate(size, 0);
+        auto res = h.lookup((char*)p.get() + size - 1);
+        EXPECT_TRUE(res);
+        EXPECT_EQ(res.m_block.get(), p.get());
+        EXPECT_EQ(res.m_handle.ptr, p.handle().ptr);
+        EXPECT_EQ(res.m_numa_node, 0u);
+        h.free(p.get());
+    }
+
+    // unknown addresses
+    int x = 0;
+    EXPECT_FALSE(h.lookup(&x));
+    EXPECT_FALSE(h.lookup(nullptr));
+    EXPECT_THROW(h.free(&x), std::runtime_error);
+
+    // interior pointers free their block
+    auto p = h.allocate(4096, 0);
+    h.free((char*)p.get() + 100);
+    EXPECT_EQ(h.stats().m_large.m_num_segments, 1u);
+    h.purge();
+
+    // heaps which do not use the page map do not enter their blocks
+    heap_t g(&c);
+    auto   q = g.allocate(24, 0);
+    EXPECT_FALSE(h.lookup(q.get()));
+    g.free(q);
+
+    // blocks of other heaps on the same context are not found
+    heap_t f(&c, config);
+    for (std::size_t size : {24u, 10u * 1048576u})
+    {
+        auto r = f.allocate(size, 0);
+        EXPECT_TRUE(f.lookup(r.get()));
+        EXPECT_FALSE(h.lookup(r.get()));
+        EXPECT_THROW(h.free(r.get()), std::runtime_error);
+        f.free(r.get());
+    }
+}
+
+TEST(heap, lazy_handles)
+{
+    using heap_t = hwmalloc::heap<lazy_context>;
+
+    static_assert(sizeof(hwmalloc::detail::block_t<lazy_context>) <
+                      sizeof(hwmalloc::detail::block_t<context>),
+        "lazy blocks do not store the handle");
+
+    lazy_context c;
+
+    const std::size_t MiB = 1048576u;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = 64 * MiB;
+    heap_t h(&c, config);
+
+    for (std::size_t size : {8u, 200u, 5000u, 3u * 1048576u, 10u * 1048576u})
+    {
+        auto p = h.allocate(size, 0);
+        EXPECT_EQ(p.handle().ptr, p.get());
+        auto q = static_cast<heap_t::typed_pointer<int>>(p) + 1;
+        EXPECT_EQ(q.handle().ptr, p.get());
+        h.free(p);
+    }
+
+    std::vector<char> buffer(1000);
+    auto              u = h.register_user_allocation(buffer.data(), buffer.size());
+    EXPECT_EQ(u.handle().ptr, buffer.data());
+    h.free(u);
+
+    // compact pointers on top of lazy handles
+    hwmalloc::compact_heap<lazy_context> ch(&c);
+    auto                                 p = ch.allocate(100, 0);
+    EXPECT_EQ(p.handle().ptr, p.get());
+    ch.free(p);
+}
+
+TEST(heap, registration_cache)
+{
+    using heap_t = hwmalloc::heap<counting_context>;
+
+    counting_context c;
+
+    const auto page = hwmalloc::numa().page_size();
+    auto       config = hwmalloc::get_default_heap_config();
+    config.m_registration_cache = true;
+    config.m_registration_cache_limit = 4 * page;
+    heap_t h(&c, config);
+
+    auto buffer = (char*)std::aligned_alloc(page, 16 * page);
+
+    // the same range is registered once
+    for (int i = 0; i < 10; ++i)
+    {
+        auto u = h.register_user_allocation(buffer, 1000);
+        EXPECT_EQ(u.handle().ptr, buffer);
+        h.free(u);
+    }
+    EXPECT_EQ(c.m_registrations, 1);
+
+    // covered sub-ranges share the registration
+    auto u1 = h.register_user_allocation(buffer + 100, 200);
+    EXPECT_EQ(u1.handle().ptr, buffer + 100);
+    EXPECT_EQ(c.m_registrations, 1);
+
+    // an overlapping range is merged into a new registration, u1 remains valid
+    auto u2 = h.register_user_allocation(buffer + page / 2, 2 * page);
+    EXPECT_EQ(c.m_registrations, 2);
+    auto u3 = h.register_user_allocation(buffer, page);
+    EXPECT_EQ(c.m_registrations, 2);
+    EXPECT_EQ(u1.handle().ptr, buffer + 100);
+    EXPECT_EQ(u3.handle().ptr, buffer);
+    h.free(u1);
+    h.free(u2);
+    h.free(u3);
+
+    // the unused 3 pages are evicted to make room for 2 more
+    auto v = h.register_user_allocation(buffer + 8 * page, 2 * page);
+    EXPECT_EQ(c.m_registrations, 3);
+    h.free(v);
+    auto w = h.register_user_allocation(buffer, 10);
+    EXPECT_EQ(c.m_registrations, 4);
+    h.free(w);
+
+    // invalidated ranges are registered again
+    h.invalidate_user_allocations(buffer, 16 * page);
+    auto x = h.register_user_allocation(buffer + 8 * page, 10);
+    EXPECT_EQ(c.m_registrations, 5);
+    h.free(x);
+
+    // a range dropped while in use counts towards the limit until it is released
+    hwmalloc::detail::registration_cache<counting_context> cache(&c, 4 * page);
+    auto e1 = cache.acquire(buffer, page);
+    auto e2 = cache.acquire(buffer + page / 2, page);
+    EXPECT_EQ(cache.size(), 1u);
+    EXPECT_EQ(cache.registered_bytes(), 3 * page);
+    cache.release(e1);
+    EXPECT_EQ(cache.registered_bytes(), 2 * page);
+    cache.release(e2);
+    EXPECT_EQ(cache.registered_bytes(), 2 * page);
+    cache.invalidate(buffer, 16 * page);
+    EXPECT_EQ(cache.registered_bytes(), 0u);
+    EXPECT_EQ(cache.size(), 0u);
+
+    std::free(buffer);
+}
+
+TEST(heap, segment_arenas)
+{
+    using heap_t = hwmalloc::heap<counting_context>;
+
+    counting_context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_segment_arenas = true;
+    config.m_segment_arena_size = 64 * 1024 * 1024;
+    config.m_page_map = true;
+    heap_t h(&c, config);
+
+    // segments of all size classes share the registration of a single arena
+    std::vector<heap_t::pointer> ptrs;
+    for (std::size_t size : {8u, 100u, 4096u, 100000u, 1048576u})
+        for (int i = 0; i < 4; ++i) ptrs.push_back(h.allocate(size, 0));
+    EXPECT_EQ(c.m_registrations, 1);
+    for (auto& p : ptrs)
+    {
+        EXPECT_EQ(p.handle().ptr, p.get());
+        // the page map refers to the segments, not to the extents they were carved from
+        EXPECT_EQ(h.lookup(p.get()).m_block.get(), p.get());
+    }
+
+    const auto stats = h.stats();
+    EXPECT_EQ(stats.m_segment_arenas.m_num_segments, 1u);
+    EXPECT_EQ(stats.m_segment_arenas.m_registered_bytes, 64u * 1024 * 1024);
+    EXPECT_GE(stats.total().m_num_segments, 5u);
+
+    for (auto& p : ptrs) h.free(p);
+    h.purge();
+    EXPECT_EQ(c.m_registrations, 1);
+}
+
+TEST(heap, huge_pages)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    const std::size_t huge_page_size = 2 * 1024 * 1024;
+    auto              config = hwmalloc::get_default_heap_config();
+    config.m_huge_page_size = huge_page_size;
+    config.m_huge_extents = true;
+    config.m_extent_arena_size = huge_page_size + 1;
+    heap_t h(&c, config);
+
+    // arenas are rounded up to the huge page size
+    auto p = h.allocate(10 * 1024 * 1024, 0);
+    EXPECT_EQ((std::uintptr_t)p.get() % huge_page_size, 0u);
+    EXPECT_EQ(p.handle().ptr, p.get());
+    std::memset(p.get(), 1, 10 * 1024 * 1024);
+    auto q = h.allocate(100, 0);
+    EXPECT_EQ(q.handle().ptr, q.get());
+    const auto stats = h.stats();
+    EXPECT_EQ(stats.m_huge.m_registered_bytes, 5 * huge_page_size);
+    h.free(p);
+    h.free(q);
+}
+
+TEST(heap, allocate_zeroed)
+{
+    using heap_t = hwmalloc::heap<context>;
+    using pool_t = hwmalloc::detail::pool<context>;
+
+    context c;
+
+    // segments backed by mmap are zero-filled until the first block is returned
+    const std::size_t            huge_page_size = 2 * 1024 * 1024;
+    hwmalloc::detail::pool_config pool_config;
+    pool_config.m_huge_page_size = huge_page_size;
+    {
+        pool_t pool(&c, 64, huge_page_size, 0, false, 1, pool_config);
+        auto   b = pool.allocate();
+        EXPECT_TRUE(b.m_segment->fresh());
+        pool.free(b);
+        EXPECT_FALSE(b.m_segment->fresh());
+    }
+
+    for (bool arenas : {false, true})
+    {
+        auto config = hwmalloc::get_default_heap_config();
+        config.m_huge_page_size = huge_page_size;
+        config.m_segment_arenas = arenas;
+        config.m_segment_arena_size = 64 * 1024 * 1024;
+        config.m_huge_extents = true;
+        heap_t h(&c, config);
+
+        for (std::size_t size : {100u, 5000u, 10000000u})
+        {
+            auto p = h.allocate_zeroed(size, 0);
+            for (std::size_t i = 0; i < size; ++i) ASSERT_EQ(((char*)p.get())[i], 0);
+            std::memset(p.get(), 1, size);
+            h.free(p);
+            // recycled memory is zeroed explicitly
+            auto q = h.allocate_zeroed(size, 0);
+            for (std::size_t i = 0; i < size; ++i) ASSERT_EQ(((char*)q.get())[i], 0);
+            h.free(q);
+        }
+    }
+}
+
+TEST(heap, memory_limit)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_memory_limit = 4 * config.m_large_segment_size;
+    config.m_num_reserve_segments = 1;
+    heap_t h(&c, config);
+
+    // huge allocations are backed by a segment each
+    std::vector<heap_t::pointer> ptrs;
+    for (int i = 0; i < 4; ++i) ptrs.push_back(h.allocate(config.m_large_segment_size, 0));
+    EXPECT_EQ(h.memory_usage(), 4 * config.m_large_segment_size);
+    EXPECT_THROW(h.allocate(config.m_large_segment_size, 0), hwmalloc::budget_exceeded);
+    EXPECT_EQ(h.memory_usage(), 4 * config.m_large_segment_size);
+
+    // memory is returned to the budget when segments are released
+    h.free(ptrs.front());
+    ptrs.erase(ptrs.begin());
+    EXPECT_EQ(h.memory_usage(), 3 * config.m_large_segment_size);
+    ptrs.push_back(h.allocate(8, 0));
+    for (auto& p : ptrs) h.free(p);
+
+    // null pointers instead of exceptions
+    config.m_memory_limit_throws = false;
+    config.m_memory_limit = 2 * config.m_large_segment_size;
+    heap_t g(&c, config);
+    auto   p = g.allocate(config.m_large_segment_size, 0);
+    auto   q = g.allocate(config.m_large_segment_size, 0);
+    EXPECT_TRUE(p.get() != nullptr);
+    EXPECT_TRUE(q.get() != nullptr);
+    EXPECT_TRUE(g.allocate(config.m_large_segment_size, 0).get() == nullptr);
+    std::vector<heap_t::pointer> bulk;
+    g.allocate_bulk(config.m_large_segment_size, 0, 2, std::back_inserter(bulk));
+    ASSERT_EQ(bulk.size(), 2u);
+    EXPECT_TRUE(bulk[0].get() == nullptr);
+    EXPECT_TRUE(bulk[1].get() == nullptr);
+
+    // objects and containers can not be built in null pointers
+    EXPECT_THROW(g.make_unique<char[]>(0, config.m_large_segment_size), std::bad_alloc);
+    using big = std::array<char, 4194304>;
+    EXPECT_THROW(g.make_unique<big>(0), std::bad_alloc);
+    std::vector<char, heap_t::allocator_type<char>> v(g.get_allocator<char>(0));
+    EXPECT_THROW(v.resize(config.m_large_segment_size), std::bad_alloc);
+    g.free(p);
+    g.free(q);
+}
+
+TEST(heap, size_class_steps)
+{
+    using heap_t = hwmalloc::heap<context>;
+
+    context c;
+
+    auto config = hwmalloc::get_default_heap_config();
+    config.m_size_class_steps = 4;
+    heap_t h(&c, config);
+
+    // a 1.1MiB allocation is served from a 1.25MiB segment instead of a 2MiB one
+    auto p = h.allocate(1153434, 0);
+    EXPECT_EQ(h.stats().m_large.m_registered_bytes, 1310720u);
+    h.free(p);
+
+    for (std::size_t size = 1; size < (1u << 23); size = size * 5 / 4 + 1)
+    {
+        auto q = h.allocate(size, 0);
+        std::memset(q.get(), 0, size);
+        h.free(q);
+    }
+}
@@ -34,6 +34,38 @@ TEST(heap_config, defaults)
     EXPECT_EQ(config.m_num_tiny_heaps, hwmalloc::test::num_tiny_heaps_default);
     EXPECT_EQ(config.m_num_small_heaps, hwmalloc::test::num_small_heaps_default);
     EXPECT_EQ(config.m_num_large_heaps, hwmalloc::test::num_large_heaps_default);
+    EXPECT_EQ(config.m_thread_cache_size, hwmalloc::heap_config::thread_cache_size_default);
+    EXPECT_EQ(config.m_thread_cache_max_bytes,
+        hwmalloc::heap_config::thread_cache_max_bytes_default);
+    EXPECT_EQ(config.m_lazy_carving, hwmalloc::heap_config::lazy_carving_default);
+    EXPECT_EQ(config.m_provision_low_watermark,
+        hwmalloc::heap_config::provision_low_watermark_default);
+    EXPECT_EQ(config.m_provision_high_watermark,
+        hwmalloc::heap_config::provision_high_watermark_default);
+    EXPECT_EQ(config.m_segment_decay_ms, hwmalloc::heap_config::segment_decay_ms_default);
+    EXPECT_EQ(config.m_tiny_madvise, hwmalloc::heap_config::madvise_default);
+    EXPECT_EQ(config.m_small_madvise, hwmalloc::heap_config::madvise_default);
+    EXPECT_EQ(config.m_large_madvise, hwmalloc::heap_config::madvise_default);
+    EXPECT_EQ(config.m_huge_madvise, hwmalloc::heap_config::madvise_default);
+    EXPECT_EQ(config.m_tiny_prefault, hwmalloc::heap_config::prefault_default);
+    EXPECT_EQ(config.m_small_prefault, hwmalloc::heap_config::prefault_default);
+    EXPECT_EQ(config.m_large_prefault, hwmalloc::heap_config::prefault_default);
+    EXPECT_EQ(config.m_huge_prefault, hwmalloc::heap_config::prefault_default);
+    EXPECT_EQ(config.m_memory_limit, hwmalloc::heap_config::memory_limit_default);
+    EXPECT_EQ(config.m_memory_soft_limit, hwmalloc::heap_config::memory_limit_default);
+    EXPECT_EQ(config.m_numa_memory_limit, hwmalloc::heap_config::memory_limit_default);
+    EXPECT_EQ(config.m_memory_limit_throws, hwmalloc::heap_config::memory_limit_throws_default);
+    EXPECT_EQ(config.m_size_class_steps, hwmalloc::heap_config::size_class_steps_default);
+    EXPECT_EQ(config.m_huge_extents, hwmalloc::heap_config::huge_extents_default);
+    EXPECT_EQ(config.m_extent_arena_size, hwmalloc::heap_config::extent_arena_size_default);
+    EXPECT_EQ(config.m_registration_cache, hwmalloc::heap_config::registration_cache_default);
+    EXPECT_EQ(config.m_registration_cache_limit,
+        hwmalloc::heap_config::registration_cache_limit_default);
+    EXPECT_EQ(config.m_segment_arenas, hwmalloc::heap_config::segment_arenas_default);
+    EXPECT_EQ(config.m_segment_arena_size, hwmalloc::heap_config::segment_arena_size_default);
+    EXPECT_EQ(config.m_huge_page_size, hwmalloc::heap_config::huge_page_size_default);
+    EXPECT_EQ(config.m_hugetlb, hwmalloc::heap_config::hugetlb_default);
+    EXPECT_EQ(config.m_page_map, hwmalloc::heap_config::page_map_default);
 }
 
 // We try changing one parameter a time compared to the defaults and check that
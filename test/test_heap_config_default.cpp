@@ -25,6 +25,30 @@ TEST(config, defaults)
     ::setenv("HWMALLOC_TINY_SEGMENT_SIZE", "16384", 1);
     ::setenv("HWMALLOC_SMALL_SEGMENT_SIZE", "32768", 1);
     ::setenv("HWMALLOC_LARGE_SEGMENT_SIZE", "262144", 1);
+    ::setenv("HWMALLOC_THREAD_CACHE_SIZE", "64", 1);
+    ::setenv("HWMALLOC_THREAD_CACHE_MAX_BYTES", "65536", 1);
+    ::setenv("HWMALLOC_LAZY_CARVING", "1", 1);
+    ::setenv("HWMALLOC_PROVISION_LOW_WATERMARK", "1", 1);
+    ::setenv("HWMALLOC_PROVISION_HIGH_WATERMARK", "4", 1);
+    ::setenv("HWMALLOC_SEGMENT_DECAY_MS", "250", 1);
+    ::setenv("HWMALLOC_SMALL_MADVISE", "1", 1);
+    ::setenv("HWMALLOC_HUGE_MADVISE", "1", 1);
+    ::setenv("HWMALLOC_TINY_PREFAULT", "1", 1);
+    ::setenv("HWMALLOC_LARGE_PREFAULT", "1", 1);
+    ::setenv("HWMALLOC_MEMORY_LIMIT", "1073741824", 1);
+    ::setenv("HWMALLOC_MEMORY_SOFT_LIMIT", "536870912", 1);
+    ::setenv("HWMALLOC_NUMA_MEMORY_LIMIT", "268435456", 1);
+    ::setenv("HWMALLOC_MEMORY_LIMIT_THROWS", "0", 1);
+    ::setenv("HWMALLOC_SIZE_CLASS_STEPS", "4", 1);
+    ::setenv("HWMALLOC_HUGE_EXTENTS", "1", 1);
+    ::setenv("HWMALLOC_EXTENT_ARENA_SIZE", "67108864", 1);
+    ::setenv("HWMALLOC_REGISTRATION_CACHE", "1", 1);
+    ::setenv("HWMALLOC_REGISTRATION_CACHE_LIMIT", "16777216", 1);
+    ::setenv("HWMALLOC_SEGMENT_ARENAS", "1", 1);
+    ::setenv("HWMALLOC_SEGMENT_ARENA_SIZE", "134217728", 1);
+    ::setenv("HWMALLOC_HUGE_PAGE_SIZE", "2097152", 1);
+    ::setenv("HWMALLOC_HUGETLB", "1", 1);
+    ::setenv("HWMALLOC_PAGE_MAP", "1", 1);
 
     hwmalloc::heap_config config = hwmalloc::get_default_heap_config();
 
@@ -42,4 +66,32 @@ TEST(config, defaults)
     EXPECT_EQ(config.m_num_tiny_heaps, 64u);
     EXPECT_EQ(config.m_num_small_heaps, 2u);
     EXPECT_EQ(config.m_num_large_heaps, 6u);
+    EXPECT_EQ(config.m_thread_cache_size, 64u);
+    EXPECT_EQ(config.m_thread_cache_max_bytes, 65536u);
+    EXPECT_EQ(config.m_lazy_carving, true);
+    EXPECT_EQ(config.m_provision_low_watermark, 1u);
+    EXPECT_EQ(config.m_provision_high_watermark, 4u);
+    EXPECT_EQ(config.m_segment_decay_ms, 250u);
+    EXPECT_EQ(config.m_tiny_madvise, false);
+    EXPECT_EQ(config.m_small_madvise, true);
+    EXPECT_EQ(config.m_large_madvise, false);
+    EXPECT_EQ(config.m_huge_madvise, true);
+    EXPECT_EQ(config.m_tiny_prefault, true);
+    EXPECT_EQ(config.m_small_prefault, false);
+    EXPECT_EQ(config.m_large_prefault, true);
+    EXPECT_EQ(config.m_huge_prefault, false);
+    EXPECT_EQ(config.m_memory_limit, 1073741824u);
+    EXPECT_EQ(config.m_memory_soft_limit, 536870912u);
+    EXPECT_EQ(config.m_numa_memory_limit, 268435456u);
+    EXPECT_EQ(config.m_memory_limit_throws, false);
+    EXPECT_EQ(config.m_size_class_steps, 4u);
+    EXPECT_EQ(config.m_huge_extents, true);
+    EXPECT_EQ(config.m_extent_arena_size, 67108864u);
+    EXPECT_EQ(config.m_registration_cache, true);
+    EXPECT_EQ(config.m_registration_cache_limit, 16777216u);
+    EXPECT_EQ(config.m_segment_arenas, true);
+    EXPECT_EQ(config.m_segment_arena_size, 134217728u);
+    EXPECT_EQ(config.m_huge_page_size, 2097152u);
+    EXPECT_EQ(config.m_hugetlb, true);
+    EXPECT_EQ(config.m_page_map, true);
 }
@@ -0,0 +1,41 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <gtest/gtest.h>
+
+#include <hwmalloc/detail/memory_budget.hpp>
+
+TEST(memory_budget, limits)
+{
+    using budget_t = hwmalloc::detail::memory_budget;
+
+    budget_t b(0u, 100u, 0u);
+    int      num_purges = 0;
+    b.set_purge_callback([&num_purges]() { ++num_purges; });
+    b.reserve(0, 50);
+    EXPECT_EQ(num_purges, 0);
+    b.reserve(0, 60);
+    EXPECT_EQ(num_purges, 1);
+    EXPECT_EQ(b.used(), 110u);
+    b.release(0, 110);
+    EXPECT_EQ(b.used(), 0u);
+
+    // a failed reservation purges once before giving up
+    budget_t n(0u, 0u, 100u);
+    n.set_purge_callback([&num_purges]() { ++num_purges; });
+    n.reserve(0, 80);
+    EXPECT_THROW(n.reserve(0, 30), hwmalloc::budget_exceeded);
+    EXPECT_EQ(num_purges, 2);
+    EXPECT_EQ(n.used(0), 80u);
+
+    // a cleared callback is not invoked any more
+    n.set_purge_callback({});
+    EXPECT_THROW(n.reserve(0, 30), hwmalloc::budget_exceeded);
+    EXPECT_EQ(num_purges, 2);
+}
@@ -8,10 +8,13 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 #include <string>
+#include <cstdint>
 #include <gtest/gtest.h>
 
 #include <hwmalloc/numa.hpp>
+#include <sys/mman.h>
 #include <iostream>
+#include <vector>
 
 TEST(numa, discover)
 {
@@ -75,3 +78,77 @@ TEST(numa, allocate)
     EXPECT_FALSE(d);             // not a valid allocation
     numa().free(d);              // should succeed
 }
+
+TEST(numa, release_pages)
+{
+    using namespace hwmalloc;
+
+    auto a = numa().allocate(16, 0);
+    EXPECT_TRUE(a);
+    auto p = static_cast<char*>(a.ptr);
+    for (std::size_t i = 0; i < a.size; ++i) p[i] = 1;
+
+    // only whole pages are released
+    const auto n = numa().release_pages(a.ptr, a.size);
+    EXPECT_EQ(n % numa().page_size(), 0u);
+    EXPECT_GE(n, 15 * numa().page_size());
+    EXPECT_LE(n, a.size);
+    EXPECT_EQ(numa().release_pages(a.ptr, numa().page_size() / 2), 0u);
+
+    // the memory is still usable
+    for (std::size_t i = 0; i < a.size; ++i) p[i] = 2;
+    numa().free(a);
+}
+
+TEST(numa, allocate_huge)
+{
+    using namespace hwmalloc;
+
+    const std::size_t huge_page_size = 2 * 1024 * 1024;
+    for (bool hugetlb : {false, true})
+    {
+        // falls back to transparent huge pages or regular pages if none are available
+        auto a = numa().allocate_huge(2 * huge_page_size, 0, huge_page_size, hugetlb);
+        EXPECT_TRUE(a);
+        EXPECT_EQ(a.node, 0);
+        EXPECT_EQ(a.size, 2 * huge_page_size);
+        EXPECT_EQ((std::uintptr_t)a.ptr % huge_page_size, 0u);
+        EXPECT_TRUE(a.page_size == huge_page_size || a.page_size == numa().page_size());
+        EXPECT_TRUE(a.use_munmap);
+        std::cout << "hugetlb " << hugetlb << ": page size " << a.page_size << std::endl;
+
+        auto p = static_cast<char*>(a.ptr);
+        for (std::size_t i = 0; i < a.size; i += numa().page_size()) p[i] = 1;
+        EXPECT_EQ(numa().release_pages(a.ptr, a.size, a.page_size), a.size);
+        // released pages read as zero
+        EXPECT_EQ(p[0], 0);
+        numa().free(a);
+    }
+
+    // sizes which are not a multiple of the huge page size use regular pages
+    auto b = numa().allocate_huge(huge_page_size + numa().page_size(), 0, huge_page_size, false);
+    EXPECT_TRUE(b);
+    EXPECT_EQ(b.page_size, numa().page_size());
+    EXPECT_FALSE(b.use_munmap);
+    numa().free(b);
+}
+
+TEST(numa, populate_pages)
+{
+    using namespace hwmalloc;
+
+    auto a = numa().allocate(16, 0);
+    EXPECT_TRUE(a);
+    auto p = static_cast<char*>(a.ptr);
+    p[0] = 42;
+    numa().release_pages(a.ptr, a.size);
+
+    // all pages are resident afterwards, the content is kept
+    p[numa().page_size()] = 43;
+    numa().populate_pages(a.ptr, a.size);
+    std::vector<unsigned char> resident(16);
+    EXPECT_EQ(mincore(a.ptr, a.size, resident.data()), 0);
+    for (auto r : resident) EXPECT_TRUE(r & 1);
+    EXPECT_EQ(p[numa().page_size()], 43);
+    numa().free(a);
+}
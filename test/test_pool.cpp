@@ -0,0 +1,405 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <gtest/gtest.h>
+
+#include <hwmalloc/detail/pool.hpp>
+#include <hwmalloc/heap.hpp>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <cstring>
+#include <atomic>
+#include <sys/mman.h>
+
+#include "./context.hpp"
+
+// pools of single pages on numa node 0 which keep one reserve segment: tests adjust the config
+// before constructing them
+class pool : public ::testing::Test
+{
+  protected:
+    using pool_t = hwmalloc::detail::pool<context>;
+    using block_t = pool_t::block_type;
+
+    context                       c;
+    hwmalloc::detail::pool_config config;
+    const std::size_t             page = hwmalloc::numa().page_size();
+};
+
+TEST_F(pool, lazy_carving)
+{
+    for (bool lazy : {true, false})
+    {
+        config.m_lazy_carving = lazy;
+        pool_t p(&c, 8, page, 0, false, 1, config);
+
+        // all blocks of a segment are handed out exactly once, in address order
+        const std::size_t    n = page / 8;
+        std::vector<block_t> blocks;
+        std::set<void*>      ptrs;
+        for (std::size_t i = 0; i < 2 * n; ++i)
+        {
+            blocks.push_back(p.allocate());
+            ptrs.insert(blocks.back().m_ptr);
+        }
+        EXPECT_EQ(ptrs.size(), 2 * n);
+        for (std::size_t i = 1; i < n; ++i)
+            EXPECT_EQ((char*)blocks[i].m_ptr, (char*)blocks[0].m_ptr + i * 8);
+        for (auto& b : blocks) p.free(b);
+
+        // freed blocks are reused
+        for (std::size_t i = 0; i < 2 * n; ++i)
+        {
+            auto b = p.allocate();
+            EXPECT_TRUE(ptrs.count(b.m_ptr));
+            p.free(b);
+        }
+    }
+}
+
+TEST_F(pool, provisioning)
+{
+    hwmalloc::detail::provisioner provisioner;
+    for (bool lazy : {true, false})
+    {
+        config.m_lazy_carving = lazy;
+        config.m_provisioner = &provisioner;
+        config.m_provision_low_watermark = 1;
+        config.m_provision_high_watermark = 2;
+        pool_t p(&c, 8, page, 0, false, 1, config);
+        EXPECT_EQ(p.num_spare_segments(), 0u);
+
+        // the first segment is built synchronously and triggers provisioning
+        const std::size_t    n = page / 8;
+        std::vector<block_t> blocks;
+        blocks.push_back(p.allocate());
+        while (p.num_spare_segments() < 2) std::this_thread::yield();
+
+        // further segments are taken from the spares
+        std::set<void*> ptrs;
+        for (std::size_t i = 1; i < 3 * n; ++i) blocks.push_back(p.allocate());
+        for (auto& b : blocks) ptrs.insert(b.m_ptr);
+        EXPECT_EQ(ptrs.size(), 3 * n);
+        for (auto& b : blocks) p.free(b);
+    }
+
+    // pools withdraw pending requests on destruction
+    config.m_provision_low_watermark = 4;
+    config.m_provision_high_watermark = 8;
+    for (int i = 0; i < 16; ++i)
+    {
+        pool_t p(&c, 8, page, 0, false, 1, config);
+        p.free(p.allocate());
+    }
+}
+
+TEST_F(pool, concurrent_growth)
+{
+    for (bool lazy : {true, false})
+    {
+        config.m_lazy_carving = lazy;
+        pool_t p(&c, 64, page, 0, false, 1, config);
+
+        // all threads hit the empty pool at the same time
+        const std::size_t                 n = 4 * page / 64;
+        const int                         num_threads = 8;
+        std::vector<std::vector<block_t>> blocks(num_threads);
+        std::atomic<int>                  ready{0};
+        std::vector<std::thread>          threads;
+        for (int i = 0; i < num_threads; ++i)
+            threads.emplace_back(
+                [&, i]()
+                {
+                    ++ready;
+                    while (ready < num_threads) std::this_thread::yield();
+                    for (std::size_t j = 0; j < n; ++j) blocks[i].push_back(p.allocate());
+                });
+        for (auto& t : threads) t.join();
+
+        std::set<void*> ptrs;
+        for (auto& v : blocks)
+            for (auto& b : v) ptrs.insert(b.m_ptr);
+        EXPECT_EQ(ptrs.size(), num_threads * n);
+        for (auto& v : blocks)
+            for (auto& b : v) p.free(b);
+    }
+}
+
+TEST_F(pool, decay)
+{
+    config.m_segment_decay_ms = 50;
+    pool_t p(&c, 64, page, 0, false, 1, config);
+
+    const std::size_t    n = page / 64;
+    std::vector<block_t> blocks;
+    auto                 fill = [&]()
+    {
+        for (std::size_t i = 0; i < 3 * n; ++i) blocks.push_back(p.allocate());
+    };
+    auto drain = [&]()
+    {
+        for (auto& b : blocks) p.free(b);
+        blocks.clear();
+    };
+
+    // empty segments are kept and reused
+    fill();
+    EXPECT_EQ(p.num_segments(), 3u);
+    drain();
+    EXPECT_EQ(p.num_segments(), 3u);
+    fill();
+    EXPECT_EQ(p.num_segments(), 3u);
+    drain();
+
+    // and released on purge
+    p.purge();
+    EXPECT_EQ(p.num_segments(), 1u);
+
+    // or once the decay time has passed
+    fill();
+    drain();
+    EXPECT_EQ(p.num_segments(), 3u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    p.free(p.allocate());
+    EXPECT_EQ(p.num_segments(), 1u);
+
+    // with a worker thread, idle pools are decayed as well
+    hwmalloc::detail::provisioner worker;
+    config.m_provisioner = &worker;
+    pool_t q(&c, 64, page, 0, false, 1, config);
+    for (std::size_t i = 0; i < 3 * n; ++i) blocks.push_back(q.allocate());
+    for (auto& b : blocks) q.free(b);
+    blocks.clear();
+    EXPECT_EQ(q.num_segments(), 3u);
+    for (int i = 0; i < 100 && q.num_segments() > 1u; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(q.num_segments(), 1u);
+}
+
+TEST_F(pool, madvise)
+{
+    for (bool lazy : {false, true})
+    {
+        config.m_madvise = true;
+        config.m_lazy_carving = lazy;
+        pool_t p(&c, 64, 4 * page, 0, false, 1, config);
+
+        const std::size_t    n = 4 * page / 64;
+        std::vector<block_t> blocks;
+        for (std::size_t i = 0; i < 3 * n; ++i)
+        {
+            blocks.push_back(p.allocate());
+            std::memset(blocks.back().m_ptr, 1, 64);
+        }
+        auto s = p.stats();
+        EXPECT_EQ(s.m_num_segments, 3u);
+        EXPECT_EQ(s.m_resident_bytes, s.m_registered_bytes);
+
+        // empty segments keep their registration but not their pages, except for the reserve
+        for (auto& b : blocks) p.free(b);
+        blocks.clear();
+        s = p.stats();
+        EXPECT_EQ(s.m_num_segments, 3u);
+        EXPECT_EQ(s.m_resident_bytes, s.m_registered_bytes / 3);
+
+        // and are reused without growing the pool
+        for (std::size_t i = 0; i < 3 * n; ++i)
+        {
+            blocks.push_back(p.allocate());
+            std::memset(blocks.back().m_ptr, 1, 64);
+        }
+        s = p.stats();
+        EXPECT_EQ(s.m_num_segments, 3u);
+        EXPECT_EQ(s.m_resident_bytes, s.m_registered_bytes);
+        for (auto& b : blocks) p.free(b);
+    }
+}
+
+TEST_F(pool, thread_cache)
+{
+    config.m_thread_cache_size = 16;
+    config.m_thread_cache_max_bytes = 1024;
+    pool_t p(&c, 8, page, 0, false, 1, config);
+
+    auto work = [&p]()
+    {
+        std::vector<block_t> blocks;
+        for (unsigned int i = 0; i < 512; ++i) blocks.push_back(p.allocate());
+        for (auto& b : blocks) p.free(b);
+        for (unsigned int i = 0; i < 512; ++i)
+        {
+            auto b = p.allocate();
+            EXPECT_TRUE(b.m_ptr != nullptr);
+            p.free(b);
+        }
+    };
+
+    // threads drain their caches on exit
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) threads.emplace_back(work);
+    for (auto& t : threads) t.join();
+    work();
+
+    auto&      caches = hwmalloc::detail::thread_cache_set<context>::instance();
+    const auto bytes = caches.bytes();
+    {
+        // a refill takes half of the capacity, a full cache flushes half of its blocks
+        pool_t               q(&c, 8, page, 0, false, 1, config);
+        std::vector<block_t> blocks;
+        blocks.push_back(q.allocate());
+        EXPECT_EQ(q.num_thread_cached_blocks(), 7u);
+        EXPECT_EQ(caches.bytes(), bytes + 7 * 8);
+        for (unsigned int i = 1; i < 32; ++i) blocks.push_back(q.allocate());
+        EXPECT_EQ(q.num_thread_cached_blocks(), 0u);
+        for (unsigned int i = 0; i < 17; ++i) q.free(blocks[i]);
+        EXPECT_EQ(q.num_thread_cached_blocks(), 9u);
+        for (unsigned int i = 17; i < 32; ++i) q.free(blocks[i]);
+        EXPECT_EQ(q.num_thread_cached_blocks(), 16u);
+        EXPECT_EQ(caches.bytes(), bytes + 16 * 8);
+    }
+    // the blocks of a destroyed pool no longer count
+    EXPECT_EQ(caches.bytes(), bytes);
+
+    {
+        // refills and frees stay within the byte limit
+        hwmalloc::detail::pool_config capped = config;
+        capped.m_thread_cache_size = 64;
+        capped.m_thread_cache_max_bytes = bytes + 512;
+        pool_t               q(&c, 64, page, 0, false, 1, capped);
+        std::vector<block_t> blocks;
+        blocks.push_back(q.allocate());
+        EXPECT_EQ(q.num_thread_cached_blocks(), 7u);
+        for (unsigned int i = 1; i < 40; ++i) blocks.push_back(q.allocate());
+        EXPECT_LE(caches.bytes(), bytes + 512);
+        for (auto& b : blocks) q.free(b);
+        EXPECT_LE(caches.bytes(), bytes + 512);
+        EXPECT_GT(q.num_thread_cached_blocks(), 0u);
+    }
+
+    {
+        // blocks larger than the byte limit are not cached at all
+        pool_t q(&c, 2048, page, 0, false, 1, config);
+        q.free(q.allocate());
+        EXPECT_EQ(q.num_thread_cached_blocks(), 0u);
+        EXPECT_EQ(caches.bytes(), bytes);
+    }
+}
+
+TEST_F(pool, thread_cache_outlives_pool)
+{
+    config.m_thread_cache_size = 16;
+    config.m_thread_cache_max_bytes = 1024;
+
+    std::mutex              m;
+    std::condition_variable cv;
+    bool                    allocated = false;
+    bool                    destroyed = false;
+
+    auto p = std::make_unique<pool_t>(&c, 8, page, 0, false, 1, config);
+    std::thread t(
+        [&]()
+        {
+            p->free(p->allocate());
+            {
+                std::lock_guard<std::mutex> lock(m);
+                allocated = true;
+            }
+            cv.notify_one();
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&destroyed] { return destroyed; });
+            // a new pool may reuse the slot of the destroyed one
+            pool_t q(&c, 8, page, 0, false, 1, config);
+            q.free(q.allocate());
+        });
+    {
+        std::unique_lock<std::mutex> lock(m);
+        cv.wait(lock, [&allocated] { return allocated; });
+        // the thread's cache still holds blocks of this pool
+        p.reset();
+        destroyed = true;
+    }
+    cv.notify_one();
+    t.join();
+}
+
+TEST_F(pool, bulk)
+{
+    for (bool lazy : {true, false})
+    {
+        config.m_lazy_carving = lazy;
+        pool_t p(&c, 8, page, 0, false, 1, config);
+
+        // the blocks of new segments are handed out in address order
+        const std::size_t    n = page / 8;
+        std::vector<block_t> blocks;
+        p.allocate_bulk(n + n / 2, std::back_inserter(blocks));
+        ASSERT_EQ(blocks.size(), n + n / 2);
+        EXPECT_EQ(p.num_segments(), 2u);
+        for (std::size_t i = 1; i < n; ++i)
+            EXPECT_EQ((char*)blocks[i].m_ptr, (char*)blocks[0].m_ptr + i * 8);
+        for (std::size_t i = n + 1; i < n + n / 2; ++i)
+            EXPECT_EQ((char*)blocks[i].m_ptr, (char*)blocks[n].m_ptr + (i - n) * 8);
+
+        // freed blocks of the first segment and the rest of the second one fill the next request
+        p.free_bulk(blocks.begin(), blocks.begin() + n / 2);
+        std::vector<block_t> more;
+        p.allocate_bulk(n, std::back_inserter(more));
+        ASSERT_EQ(more.size(), n);
+        EXPECT_EQ(p.num_segments(), 2u);
+        std::set<void*> ptrs;
+        for (std::size_t i = n / 2; i < blocks.size(); ++i) ptrs.insert(blocks[i].m_ptr);
+        for (auto& b : more) ptrs.insert(b.m_ptr);
+        EXPECT_EQ(ptrs.size(), 2 * n);
+
+        p.free_bulk(blocks.begin() + n / 2, blocks.end());
+        p.free_bulk(more.begin(), more.end());
+    }
+}
+
+TEST_F(pool, cross_thread_free)
+{
+    // small segments and a single reserve segment: segments are collected, emptied and
+    // destroyed while other threads keep freeing into them
+    pool_t p(&c, 64, page, 0, false, 1);
+
+    const int                         nthreads = 4;
+    std::vector<std::vector<block_t>> blocks(nthreads);
+    std::vector<std::thread>          threads;
+    for (int t = 0; t < nthreads; ++t)
+        threads.emplace_back(
+            [&p, &blocks, t]()
+            {
+                for (int iter = 0; iter < 100; ++iter)
+                {
+                    for (int i = 0; i < 200; ++i) blocks[t].push_back(p.allocate());
+                    // free the blocks in two halves, interleaved with other threads
+                    std::size_t n = blocks[t].size() / 2;
+                    for (std::size_t i = 0; i < n; ++i) p.free(blocks[t][i]);
+                    for (std::size_t i = n; i < blocks[t].size(); ++i) p.free(blocks[t][i]);
+                    blocks[t].clear();
+                }
+            });
+    for (auto& t : threads) t.join();
+}
+
+TEST_F(pool, prefault)
+{
+    config.m_prefault = true;
+    pool_t p(&c, 64, 64 * page, 0, false, 1, config);
+
+    // all pages of the new segment are resident before any block is touched
+    auto                       b = p.allocate();
+    std::vector<unsigned char> resident(64);
+    ASSERT_EQ(mincore(b.m_ptr, 64 * page, resident.data()), 0);
+    for (auto r : resident) EXPECT_TRUE(r & 1);
+    p.free(b);
+}
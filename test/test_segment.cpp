@@ -1,7 +1,7 @@
 /*
  * ghex-org
  *
- * Copyright (c) 2014-2023, ETH Zurich
+ * Copyright (c) 2014-2025, ETH Zurich
  * All rights reserved.
  *
  * Please, refer to the LICENSE file in the root directory.
@@ -14,52 +14,7 @@
 #include <hwmalloc/detail/fixed_size_heap.hpp>
 #include <hwmalloc/heap.hpp>
 
-#include <thread>
-
-struct context
-{
-    int m = 42;
-    context() { std::cout << "context constructor" << std::endl; }
-    ~context() { std::cout << "context destructor" << std::endl; }
-
-    struct region
-    {
-        struct handle_type
-        {
-            void* ptr;
-        };
-
-        void* ptr = nullptr;
-
-        region(void* p) noexcept
-        : ptr{p}
-        {
-        }
-
-        region(region const&) = delete;
-
-        region(region&& other) noexcept
-        : ptr{std::exchange(other.ptr, nullptr)}
-        {
-        }
-
-        ~region()
-        {
-            if (ptr) std::cout << "    region destructor" << std::endl;
-        }
-
-        handle_type get_handle(std::size_t offset, std::size_t /*size*/) const noexcept
-        {
-            return {(void*)((char*)ptr + offset)};
-        }
-    };
-};
-
-auto
-register_memory(context&, void* ptr, std::size_t)
-{
-    return context::region{ptr};
-}
+#include "./context.hpp"
 
 TEST(segment, construction)
 {
@@ -73,7 +28,9 @@ TEST(segment, construction)
 
     boost::lockfree::stack<block_t> free_stack(256);
 
-    segment_t s(nullptr, std::move(r), a, sizeof(int), free_stack);
+    segment_t s(nullptr, std::move(r), a, sizeof(int));
+    s.carve_all(free_stack);
+    EXPECT_EQ(s.num_uncarved(), 0u);
 
     while (true)
     {
@@ -91,6 +48,37 @@ TEST(segment, construction)
     s.collect(free_stack);
 }
 
+TEST(segment, lazy_carving)
+{
+    using segment_t = hwmalloc::detail::segment<context>;
+    using block_t = segment_t::block;
+
+    context c;
+
+    auto a = hwmalloc::numa().allocate(1, 0);
+    auto r = hwmalloc::register_memory(c, a.ptr, a.size);
+
+    segment_t s(nullptr, std::move(r), a, sizeof(int));
+    EXPECT_EQ(s.num_uncarved(), s.capacity());
+    EXPECT_TRUE(s.is_empty());
+
+    std::vector<block_t> blocks;
+    s.carve(16, std::back_inserter(blocks));
+    ASSERT_EQ(blocks.size(), 16u);
+    EXPECT_EQ(s.num_uncarved(), s.capacity() - 16);
+    EXPECT_FALSE(s.is_empty());
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+        EXPECT_EQ(blocks[i].m_ptr, (char*)a.ptr + i * sizeof(int));
+
+    // carving stops at the end of the segment
+    s.carve(s.capacity(), std::back_inserter(blocks));
+    EXPECT_EQ(blocks.size(), s.capacity());
+    EXPECT_EQ(s.num_uncarved(), 0u);
+
+    for (auto& b : blocks) s.free(b);
+    EXPECT_TRUE(s.is_empty());
+}
+
 TEST(pool, construction)
 {
     using pool_t = hwmalloc::detail::pool<context>;
@@ -0,0 +1,74 @@
+/*
+ * ghex-org
+ *
+ * Copyright (c) 2014-2025, ETH Zurich
+ * All rights reserved.
+ *
+ * Please, refer to the LICENSE file in the root directory.
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <gtest/gtest.h>
+
+#include <hwmalloc/detail/size_classes.hpp>
+
+TEST(size_classes, index)
+{
+    using size_classes_t = hwmalloc::detail::size_classes;
+
+    // a single step gives powers of two
+    size_classes_t p(128, 1);
+    EXPECT_EQ(p.steps(), 1u);
+    for (std::size_t n = 129; n <= (1u << 22); n += 7)
+    {
+        const auto i = p.index(n);
+        EXPECT_EQ(p.block_size(i), hwmalloc::detail::round_to_pow_of_2(n));
+        EXPECT_EQ(i, hwmalloc::detail::log2_c((n - 1) >> 7) - 1);
+    }
+
+    // several steps per doubling
+    size_classes_t q(128, 4);
+    EXPECT_EQ(q.steps(), 4u);
+    EXPECT_EQ(q.block_size(0), 160u);
+    EXPECT_EQ(q.block_size(3), 256u);
+    EXPECT_EQ(q.block_size(4), 320u);
+    EXPECT_EQ(q.round_up(4200), 5120u);
+    EXPECT_EQ(q.round_up(1153434), 1310720u);
+    std::size_t last = 128;
+    for (std::size_t i = 0; i < q.num_classes(1u << 22); ++i)
+    {
+        const auto b = q.block_size(i);
+        EXPECT_GT(b, last);
+        EXPECT_EQ(b % 8, 0u);
+        EXPECT_EQ(q.index(b), i);
+        EXPECT_EQ(q.index(last + 1), i);
+        EXPECT_LE(b - last, b / 4 + 1);
+        last = b;
+    }
+
+    // steps are limited by the tiny increment
+    EXPECT_EQ(size_classes_t(16, 8).steps(), 2u);
+}
+
+TEST(size_classes, map)
+{
+    using map_t = hwmalloc::detail::size_class_map;
+
+    for (std::size_t steps : {1u, 4u})
+    {
+        map_t m(128, steps, 4096);
+        EXPECT_EQ(m.num_tiny(), 16u);
+        EXPECT_EQ(m.index(0), 0u);
+        EXPECT_EQ(m.block_size(0), 8u);
+        EXPECT_EQ(m.block_size(15), 128u);
+        EXPECT_EQ(m.block_size(16), m.classes().block_size(0));
+
+        // table and leading bit dispatch agree with the smallest fitting class
+        for (std::size_t n = 1; n <= (1u << 20); n += (n < 8192 ? 1 : 61))
+        {
+            const auto i = m.index(n);
+            EXPECT_GE(m.block_size(i), n);
+            if (i > 0) { EXPECT_LT(m.block_size(i - 1), n); }
+        }
+        EXPECT_EQ(m.num_classes(1u << 20), m.index(1u << 20) + 1);
+    }
+}